@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 static int createNonblocking()
@@ -14,16 +15,18 @@ static int createNonblocking()
     {
         LOG_FATAL("%s:%s:%d listen socket create error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
     }
+    return sockfd;
 }
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
     , acceptSocket_(createNonblocking())    // socket
     , acceptChannel_(loop, acceptSocket_.fd())
-    , listenning_(false) 
+    , listenning_(false)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);  // bind
 
     // TcpServer:start() -> Accept::listen()  有新用户连接时，要执行一个回调（connfd打包成channel，再给交给subLoop）
@@ -34,6 +37,10 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
 }
 
 void Acceptor::listen()
@@ -43,28 +50,71 @@ void Acceptor::listen()
     acceptChannel_.enableReading();
 }
 
-// listenfd有事件发生（新用户连接）
+// listenfd有事件发生（新用户连接），一直accept到EAGAIN，最多kMaxAcceptsPerRead次
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    int accepted = 0;
+    int shed = 0;
+    for (int i = 0; i < kMaxAcceptsPerRead; ++i)
     {
-        if (newConnectionCallback_)
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
         {
-            newConnectionCallback_(connfd, peerAddr);   // 轮询找到subLoop，唤醒，分发当前新客户端的channel
+            ++accepted;
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(connfd, peerAddr);   // 轮询找到subLoop，分发当前新客户端的channel
+            }
+            else
+            {
+                ::close(connfd);
+            }
         }
-        else
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            ::close(connfd);
+            break;  // accept队列已经空了
         }
-    }
-    else
-    {
-        LOG_ERROR("%s:%s:%d accept error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE)
+        else if (errno == EMFILE || errno == ENFILE)
         {
-            LOG_ERROR("%s:%s:%d sockfd reach limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            if (!shedConnection())
+            {
+                break;
+            }
+            ++shed;
         }
+        else if (errno != ECONNABORTED && errno != EINTR && errno != EPROTO && errno != EPERM)
+        {
+            LOG_ERROR("%s:%s:%d accept error:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+            break;
+        }
+        // 其余的错误只影响这一个连接，接着accept
     }
-}
\ No newline at end of file
+
+    if (shed > 0)
+    {
+        LOG_ERROR("%s:%s:%d sockfd reach limit! shed %d connections \n", __FILE__, __FUNCTION__, __LINE__, shed);
+    }
+    if (accepted > 0 && acceptBatchCallback_)
+    {
+        acceptBatchCallback_();
+    }
+}
+
+// fd用完了：关掉预留的fd腾出位置，接受一个连接马上关闭，对端能收到FIN，不会一直等在accept队列里
+bool Acceptor::shedConnection()
+{
+    if (idleFd_ < 0)
+    {
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return false;
+    }
+    ::close(idleFd_);
+    int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (connfd >= 0)
+    {
+        ::close(connfd);
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return connfd >= 0;
+}
@@ -13,21 +13,31 @@ class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
+    using AcceptBatchCallback = std::function<void()>;
 
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    // 一次读事件里可能接受多个连接（每个都调用newConnectionCallback），全部交出去之后调用一次这个回调
+    void setAcceptBatchCallback(const AcceptBatchCallback &cb) { acceptBatchCallback_ = cb; }
 
+    EventLoop *getLoop() const { return loop_; }
     bool listenning() const { return listenning_; }
     void listen();
 
+    // 一次读事件最多accept这么多次，剩下的下一轮poll再处理（listenfd是水平触发），免得其他Channel饿死
+    static const int kMaxAcceptsPerRead = 64;
+
 private:
     void handleRead();
+    bool shedConnection();
 
-    EventLoop *loop_; ///< Acceptor用的就是用户定义的那个baseLoop（mainLoop），工作在mainReactor中
+    EventLoop *loop_; ///< 一般是用户定义的那个baseLoop（mainLoop）；TcpServer::kReusePortPerLoop模式下是各个subLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    AcceptBatchCallback acceptBatchCallback_;
     bool listenning_;
+    int idleFd_; ///< 预留的fd，fd用完（EMFILE）时关掉它腾出一个位置，接受连接后马上关闭，免得listenfd一直可读让loop空转
 };
\ No newline at end of file
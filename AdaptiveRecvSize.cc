@@ -0,0 +1,59 @@
+#include "AdaptiveRecvSize.h"
+
+#include <algorithm>
+
+static const int kIndexIncrement = 4;
+static const int kIndexDecrement = 1;
+// 大小表中步长为16的部分有31项：16 ... 496
+static const int kLinearSteps = 31;
+
+AdaptiveRecvSize::AdaptiveRecvSize()
+    : index_(indexOf(kInitial))
+    , minIndex_(indexOf(kMinimum))
+    , maxIndex_(indexOf(kMaximum))
+    , nextSize_(kInitial)
+    , decreaseNow_(false)
+{
+}
+
+size_t AdaptiveRecvSize::sizeAt(int index)
+{
+    if (index < kLinearSteps)
+    {
+        return static_cast<size_t>(index + 1) * 16;
+    }
+    return static_cast<size_t>(512) << (index - kLinearSteps);
+}
+
+int AdaptiveRecvSize::indexOf(size_t size)
+{
+    int index = 0;
+    while (sizeAt(index) < size)
+    {
+        ++index;
+    }
+    return index;
+}
+
+void AdaptiveRecvSize::record(size_t actual)
+{
+    if (actual <= sizeAt(std::max(0, index_ - kIndexDecrement)))
+    {
+        if (decreaseNow_)
+        {
+            index_ = std::max(index_ - kIndexDecrement, minIndex_);
+            nextSize_ = sizeAt(index_);
+            decreaseNow_ = false;
+        }
+        else
+        {
+            decreaseNow_ = true;
+        }
+    }
+    else if (actual >= nextSize_)
+    {
+        index_ = std::min(index_ + kIndexIncrement, maxIndex_);
+        nextSize_ = sizeAt(index_);
+        decreaseNow_ = false;
+    }
+}
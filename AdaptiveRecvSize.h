@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * 按最近的读取量预测下一次读多少，和Netty的AdaptiveRecvByteBufAllocator相同的算法
+ * 大小表：16, 32, ... 496（步长16），然后512, 1024, 2048 ...（翻倍）
+ * 一次读满了预测值，预测值立刻在表中上调4格
+ * 连续两次读到的数据都不超过下一档更小的值，才下调1格，避免抖动
+ *
+ * 每个连接一个，读之前把Buffer的可写空间扩到guess()，数据就能直接落在连接的Buffer里，
+ * 不用先读到溢出区再拷贝
+ */
+class AdaptiveRecvSize
+{
+public:
+    static const size_t kMinimum = 64;
+    static const size_t kInitial = 2048;
+    static const size_t kMaximum = 65536;
+
+    AdaptiveRecvSize();
+
+    size_t guess() const { return nextSize_; }
+    // 记录一次实际读到的字节数
+    void record(size_t actual);
+
+private:
+    static size_t sizeAt(int index);
+    // 大小表中第一个不小于size的下标
+    static int indexOf(size_t size);
+
+    int index_;
+    int minIndex_;
+    int maxIndex_;
+    size_t nextSize_;
+    bool decreaseNow_;
+};
@@ -0,0 +1,192 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+    // 当前线程在哪个AsyncLogging上注册了缓冲区
+    thread_local const void *t_owner = nullptr;
+    thread_local std::shared_ptr<void> t_threadBuffer;
+}
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval)
+    : flushInterval_(flushInterval)
+    , running_(false)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , droppedBuffers_(0)
+{
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    running_ = false;
+    cond_.notify_one();
+    thread_.join();
+}
+
+AsyncLogging::BufferPtr AsyncLogging::newBuffer()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!freeBuffers_.empty())
+        {
+            BufferPtr buffer(std::move(freeBuffers_.back()));
+            freeBuffers_.pop_back();
+            return buffer;
+        }
+    }
+    return BufferPtr(new FixedBuffer);
+}
+
+// 第一次写日志时，给当前线程分配缓冲区并注册到后端
+AsyncLogging::ThreadBuffer *AsyncLogging::threadBuffer()
+{
+    if (__builtin_expect(t_owner != this, 0))
+    {
+        ThreadBufferPtr tb(new ThreadBuffer);
+        tb->current = newBuffer();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            threadBuffers_.push_back(tb);
+        }
+        t_threadBuffer = tb;
+        t_owner = this;
+    }
+    return static_cast<ThreadBuffer *>(t_threadBuffer.get());
+}
+
+void AsyncLogging::append(const char *logline, int len)
+{
+    if (len <= 0)
+    {
+        return;
+    }
+    ThreadBuffer *tb = threadBuffer();
+    std::unique_lock<std::mutex> lock(tb->mutex);
+    if (tb->current->avail() > static_cast<size_t>(len))
+    {
+        tb->current->append(logline, len);
+        return;
+    }
+
+    // 当前线程的缓冲区写满了，整块交给后端
+    BufferPtr full(std::move(tb->current));
+    tb->current = newBuffer();
+    // 比一整块缓冲区还长的日志截断
+    tb->current->append(logline, std::min(static_cast<size_t>(len), tb->current->avail()));
+    {
+        std::unique_lock<std::mutex> backendLock(mutex_);
+        buffers_.push_back(std::move(full));
+    }
+    cond_.notify_one();
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_);
+    BufferVector buffersToWrite;
+    BufferVector spares; ///< 后端自己留着的空缓冲区，用来替换前端线程没写满的缓冲区
+    std::vector<ThreadBufferPtr> threadBuffers;
+
+    bool running = true;
+    while (running)
+    {
+        running = running_;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            buffersToWrite.swap(buffers_);
+            threadBuffers = threadBuffers_;
+        }
+
+        // 把前端线程还没写满的缓冲区也换出来
+        for (const ThreadBufferPtr &tb : threadBuffers)
+        {
+            if (spares.empty())
+            {
+                spares.push_back(BufferPtr(new FixedBuffer));
+            }
+            std::unique_lock<std::mutex> lock(tb->mutex);
+            if (tb->current->length() > 0)
+            {
+                buffersToWrite.push_back(std::move(tb->current));
+                tb->current = std::move(spares.back());
+                spares.pop_back();
+            }
+        }
+
+        // 日志堆积太多，丢掉多余的，防止内存无限增长
+        if (buffersToWrite.size() > kMaxBuffersToWrite)
+        {
+            char buf[256];
+            snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers\n",
+                     Timestamp::now().toString().c_str(),
+                     buffersToWrite.size() - 2);
+            fputs(buf, stderr);
+            output.append(buf, strlen(buf));
+            droppedBuffers_ += buffersToWrite.size() - 2;
+            buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+            buffer->reset();
+        }
+        output.flush();
+
+        // 写完的缓冲区：一部分留给后端自己，剩下的还给前端
+        while (!buffersToWrite.empty() && spares.size() < 2)
+        {
+            spares.push_back(std::move(buffersToWrite.back()));
+            buffersToWrite.pop_back();
+        }
+        threadBuffers.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (BufferPtr &buffer : buffersToWrite)
+            {
+                if (freeBuffers_.size() < kMaxBuffersToWrite)
+                {
+                    freeBuffers_.push_back(std::move(buffer));
+                }
+            }
+            // 线程已经退出并且缓冲区已经清空的，不再收集
+            for (auto it = threadBuffers_.begin(); it != threadBuffers_.end();)
+            {
+                if (it->use_count() == 1 && (*it)->current->length() == 0)
+                {
+                    it = threadBuffers_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        buffersToWrite.clear();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * 异步日志后端
+ * 前端：每个写日志的线程有自己的缓冲区，append只拷贝内存，写满了才加锁把整块缓冲区交给后端
+ * 后端：单独的线程，定期（或者有写满的缓冲区时）把所有缓冲区收集起来写入滚动的日志文件
+ * 前端永远不会等待磁盘IO
+ *
+ * 使用方式：
+ *   AsyncLogging async("/tmp/server", 500 * 1024 * 1024);
+ *   async.start();
+ *   Logger::instance().setOutput(asyncOutput); // asyncOutput里调用async.append
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~AsyncLogging();
+
+    // 前端接口，线程安全
+    void append(const char *logline, int len);
+
+    void start();
+    void stop();
+
+    // 因为后端来不及写而丢掉的缓冲区个数
+    int64_t droppedBuffers() const { return droppedBuffers_; }
+
+private:
+    // 固定大小的日志缓冲区
+    class FixedBuffer : noncopyable
+    {
+    public:
+        FixedBuffer() : cur_(data_) {}
+
+        void append(const char *buf, size_t len)
+        {
+            memcpy(cur_, buf, len);
+            cur_ += len;
+        }
+
+        const char *data() const { return data_; }
+        size_t length() const { return cur_ - data_; }
+        size_t avail() const { return sizeof data_ - length(); }
+        void reset() { cur_ = data_; }
+
+    private:
+        char data_[1024 * 1024];
+        char *cur_;
+    };
+
+    using BufferPtr = std::unique_ptr<FixedBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    // 每个前端线程的缓冲区，只有后端定期收集时才会有竞争
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        BufferPtr current;
+    };
+    using ThreadBufferPtr = std::shared_ptr<ThreadBuffer>;
+
+    ThreadBuffer *threadBuffer();
+    BufferPtr newBuffer();
+    void threadFunc();
+
+    static const size_t kMaxBuffersToWrite = 25;
+
+    const int flushInterval_;
+    std::atomic_bool running_;
+    const std::string basename_;
+    const off_t rollSize_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferVector buffers_;                      ///< 写满的缓冲区，等待后端写入文件
+    BufferVector freeBuffers_;                  ///< 后端写完归还的缓冲区，前端复用
+    std::vector<ThreadBufferPtr> threadBuffers_; ///< 所有前端线程的缓冲区
+
+    std::atomic<int64_t> droppedBuffers_;
+};
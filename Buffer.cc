@@ -1,4 +1,5 @@
 #include "Buffer.h"
+#include "AdaptiveRecvSize.h"
 
 #include <errno.h>
 #include <sys/uio.h>
@@ -7,10 +8,14 @@
 /**
  * 从fd上读数据，Poller工作在LT模式
  * Buffer缓冲区是有大小的，但是从fd上读数据的时候，却不知道tcp数据最终的大小
+ * 先按预测的大小准备好可写空间，超出的部分读到extrabuf中再追加
  */
-ssize_t Buffer::readFd(int fd, int *savedErrno)
+ssize_t Buffer::readFd(int fd, int *savedErrno, char *extrabuf, size_t extrabufLen, AdaptiveRecvSize *recvSize)
 {
-    char extrabuf[65536] = {0}; // 栈上的内存空间
+    if (recvSize != nullptr)
+    {
+        ensureWritableBytes(recvSize->guess());
+    }
 
     struct iovec vec[2];
 
@@ -19,9 +24,9 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
     vec[0].iov_len = writable;
 
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_len = extrabufLen;
 
-    const int iovcnt = (writable < sizeof extrabuf ? 2 : 1);
+    const int iovcnt = (writable < extrabufLen ? 2 : 1);
     const ssize_t n = ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
@@ -33,13 +38,52 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
     }
     else // extrabuf里面也写入了数据
     {
-        writerIndex_ = buffer_.size();
+        writerIndex_ += writable;
         append(extrabuf, n - writable);
     }
 
+    if (n > 0 && recvSize != nullptr)
+    {
+        recvSize->record(n);
+    }
     return n;
 }
 
+ssize_t Buffer::readFdUntilAgain(int fd, int *savedErrno, bool *peerClosed,
+                                 char *extrabuf, size_t extrabufLen, AdaptiveRecvSize *recvSize)
+{
+    ssize_t total = 0;
+    *savedErrno = 0;
+    *peerClosed = false;
+    while (true)
+    {
+        int err = 0;
+        ssize_t n = readFd(fd, &err, extrabuf, extrabufLen, recvSize);
+        if (n > 0)
+        {
+            total += n;
+        }
+        else if (n == 0)
+        {
+            *peerClosed = true;
+            break;
+        }
+        else if (err == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            if (err != EAGAIN && err != EWOULDBLOCK)
+            {
+                *savedErrno = err;
+            }
+            break;
+        }
+    }
+    return total;
+}
+
 ssize_t Buffer::writeFd(int fd, int* savedErrno)
 {
     ssize_t n = ::write(fd, peek(), readableBytes());
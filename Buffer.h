@@ -1,9 +1,14 @@
 #pragma once
 
-#include <vector>
+#include "BufferAllocator.h"
+
 #include <cstddef>
 #include <string>
 #include <algorithm>
+#include <string.h>
+#include <sys/types.h>
+
+class AdaptiveRecvSize;
 
 // 网络库底层的缓冲区类型定义
 /// A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
@@ -16,6 +21,9 @@
 /// |                   |                  |                  |
 /// 0      <=      readerIndex   <=   writerIndex    <=     size
 /// @endcode
+///
+/// 内存在第一次写入时才分配，shrink(0)在没有可读数据时把内存整个释放，之后再写入时重新分配
+/// 内存来自BufferAllocator，按大小类向上取整，多出来的部分直接作为可写空间
 class Buffer
 {
 public:
@@ -23,10 +31,56 @@ public:
     static const size_t kInitialSize = 1024;
 
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize)
+        : initialSize_(initialSize)
+        , buffer_(nullptr)
+        , capacity_(0)
+        , readerIndex_(kCheapPrepend)
+        , writerIndex_(kCheapPrepend)
+    {
+    }
+
+    ~Buffer()
+    {
+        if (buffer_ != nullptr)
+        {
+            BufferAllocator::deallocate(buffer_, capacity_);
+        }
+    }
+
+    Buffer(const Buffer &other)
+        : initialSize_(other.initialSize_)
+        , buffer_(nullptr)
+        , capacity_(0)
         , readerIndex_(kCheapPrepend)
         , writerIndex_(kCheapPrepend)
     {
+        append(other.peek(), other.readableBytes());
+    }
+
+    // 直接接管other的内存，other变为空
+    Buffer(Buffer &&other) noexcept
+        : initialSize_(other.initialSize_)
+        , buffer_(nullptr)
+        , capacity_(0)
+        , readerIndex_(kCheapPrepend)
+        , writerIndex_(kCheapPrepend)
+    {
+        swap(other);
+    }
+
+    Buffer &operator=(Buffer other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    void swap(Buffer &other)
+    {
+        std::swap(initialSize_, other.initialSize_);
+        std::swap(buffer_, other.buffer_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(readerIndex_, other.readerIndex_);
+        std::swap(writerIndex_, other.writerIndex_);
     }
 
     size_t readableBytes() const
@@ -36,7 +90,8 @@ public:
 
     size_t writableBytes() const
     {
-        return buffer_.size() - writerIndex_;
+        // 还没有分配内存时capacity_为0，小于writerIndex_
+        return capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0;
     }
 
     size_t prependableBytes() const
@@ -44,6 +99,12 @@ public:
         return readerIndex_;
     }
 
+    // 返回缓冲区中可读数据的起始地址
+    const char *peek() const
+    {
+        return begin() + readerIndex_;
+    }
+
     // onMessage : Buffer -> string
     void retrieve(size_t len)
     {
@@ -86,8 +147,18 @@ public:
     // 把[data, data + len]内存上的数据添加到writable缓冲区中
     void append(const char* data, size_t len)
     {
+        if (len == 0)
+        {
+            return;
+        }
         ensureWritableBytes(len);
-        std::copy(data, data + len, beginWrite());
+        memcpy(beginWrite(), data, len);
+        writerIndex_ += len;
+    }
+
+    // 直接写入beginWrite()之后，移动writerIndex
+    void hasWritten(size_t len)
+    {
         writerIndex_ += len;
     }
 
@@ -101,27 +172,44 @@ public:
         return begin() + writerIndex_;
     }
 
+    // 把容量缩小到 可读数据 + reserve，没有可读数据且reserve为0时释放全部内存
+    void shrink(size_t reserve)
+    {
+        size_t readable = readableBytes();
+        if (readable == 0 && reserve == 0)
+        {
+            release();
+            return;
+        }
+        reallocate(kCheapPrepend + readable + reserve);
+    }
+
+    // 实际占用的内存
+    size_t internalCapacity() const
+    {
+        return capacity_;
+    }
+
     // 从fd上读数据
-    ssize_t readFd(int fd, int* savedErrno);
+    // extrabuf：可写空间不够时的溢出区，一般是所属EventLoop的recvArena，不需要清零
+    // recvSize：不为空时，读之前先把可写空间扩到预测的大小，读完后记录实际读到的字节数
+    ssize_t readFd(int fd, int* savedErrno, char* extrabuf, size_t extrabufLen, AdaptiveRecvSize* recvSize = nullptr);
+    // ET模式：一直读到EAGAIN或者对端关闭，返回读到的总字节数
+    // 出错时savedErrno为非EAGAIN的错误码，对端关闭时peerClosed为true，这两种情况下也可能已经读到了数据
+    ssize_t readFdUntilAgain(int fd, int* savedErrno, bool* peerClosed,
+                             char* extrabuf, size_t extrabufLen, AdaptiveRecvSize* recvSize = nullptr);
     // 通过fd发送数据
     ssize_t writeFd(int fd, int* savedErrno);
 
 private:
-    // it.operator*()
     char *begin()
     {
-        return &*buffer_.begin();
-    } // vector底层数组首元素的地址，即数组的起始地址
+        return buffer_;
+    } // 数组的起始地址，还没有分配内存时为空
 
     const char *begin() const
     {
-        return &*buffer_.begin();
-    }
-
-    // 返回缓冲区中可读数据的起始地址
-    const char *peek() const
-    {
-        return begin() + readerIndex_;
+        return buffer_;
     }
 
     void makeSpace(size_t len)
@@ -130,23 +218,56 @@ private:
             kCheapPrepend |---|reader | writer |
             kCheapPrepend |           len             |
         */
-       if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+       if (buffer_ == nullptr)
+       {
+            // 第一次写入时才分配
+            reallocate(kCheapPrepend + std::max(len, initialSize_));
+       }
+       else if (writableBytes() + prependableBytes() < len + kCheapPrepend)
        {
-            buffer_.resize(writerIndex_ + len);
+            // 至少翻倍，保证连续append的均摊复杂度
+            reallocate(std::max(kCheapPrepend + readableBytes() + len, capacity_ * 2));
        }
        else
        {
             size_t readable = readableBytes();
-            std::copy(begin() + readerIndex_,
-                      begin() + writerIndex_,
-                      begin() + kCheapPrepend);
+            memmove(begin() + kCheapPrepend, begin() + readerIndex_, readable);
             readerIndex_ = kCheapPrepend;
             writerIndex_ = readerIndex_ + readable; 
        }
     }
 
+    // 换一块至少size字节的内存，可读数据搬到kCheapPrepend处
+    void reallocate(size_t size)
+    {
+        size_t readable = readableBytes();
+        size_t capacity = 0;
+        char *buffer = static_cast<char *>(BufferAllocator::allocate(size, &capacity));
+        if (readable > 0)
+        {
+            memcpy(buffer + kCheapPrepend, peek(), readable);
+        }
+        release();
+        buffer_ = buffer;
+        capacity_ = capacity;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
+    }
+
+    void release()
+    {
+        if (buffer_ != nullptr)
+        {
+            BufferAllocator::deallocate(buffer_, capacity_);
+            buffer_ = nullptr;
+            capacity_ = 0;
+        }
+        readerIndex_ = writerIndex_ = kCheapPrepend;
+    }
 
-    std::vector<char> buffer_;
+    size_t initialSize_;
+    char *buffer_;
+    size_t capacity_;
     size_t readerIndex_;
     size_t writerIndex_;
 };
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "BufferAllocator.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdlib.h>
+
+namespace
+{
+
+const int kNumClasses = 11; ///< 64 ... 64K
+const int kMinClassShift = 6;
+const size_t kThreadCacheBytes = 256 * 1024;   ///< 每个线程每个大小类最多缓存的内存
+const size_t kCentralCacheBytes = 1024 * 1024; ///< 每个大小类中心链表最多缓存的内存
+const size_t kMinCacheBlocks = 8;
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+struct FreeList
+{
+    constexpr FreeList() : head(nullptr), count(0) {}
+
+    void push(FreeBlock *block)
+    {
+        block->next = head;
+        head = block;
+        ++count;
+    }
+
+    FreeBlock *pop()
+    {
+        FreeBlock *block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+
+    FreeBlock *head;
+    size_t count;
+};
+
+struct CentralList
+{
+    std::mutex mutex;
+    FreeList list;
+};
+
+size_t classSize(int index)
+{
+    return BufferAllocator::kMinClassSize << index;
+}
+
+int classIndex(size_t size)
+{
+    if (size <= BufferAllocator::kMinClassSize)
+    {
+        return 0;
+    }
+    // 向上取整到2的幂
+    return 64 - __builtin_clzl(size - 1) - kMinClassShift;
+}
+
+size_t threadCacheLimit(int index)
+{
+    return std::max(kMinCacheBlocks, kThreadCacheBytes / classSize(index));
+}
+
+size_t centralCacheLimit(int index)
+{
+    return std::max(kMinCacheBlocks, kCentralCacheBytes / classSize(index));
+}
+
+CentralList g_central[kNumClasses];
+std::atomic<size_t> g_reservedBytes(0);
+std::atomic<size_t> g_centralCachedBytes(0);
+
+void *mallocBlock(int index)
+{
+    void *p = ::malloc(classSize(index));
+    if (p == nullptr)
+    {
+        LOG_FATAL("BufferAllocator malloc %zu bytes failed\n", classSize(index));
+    }
+    g_reservedBytes.fetch_add(classSize(index), std::memory_order_relaxed);
+    return p;
+}
+
+// 把list中的count个块放回中心链表，中心链表满了就直接free
+void releaseToCentral(int index, FreeList *list, size_t count)
+{
+    CentralList &central = g_central[index];
+    size_t freed = 0;
+    {
+        std::lock_guard<std::mutex> lock(central.mutex);
+        size_t limit = centralCacheLimit(index);
+        for (size_t i = 0; i < count; ++i)
+        {
+            FreeBlock *block = list->pop();
+            if (central.list.count < limit)
+            {
+                central.list.push(block);
+            }
+            else
+            {
+                ::free(block);
+                ++freed;
+            }
+        }
+    }
+    size_t size = classSize(index);
+    g_centralCachedBytes.fetch_add((count - freed) * size, std::memory_order_relaxed);
+    g_reservedBytes.fetch_sub(freed * size, std::memory_order_relaxed);
+}
+
+// 从中心链表最多取count个块放进list
+void fetchFromCentral(int index, FreeList *list, size_t count)
+{
+    CentralList &central = g_central[index];
+    size_t fetched = 0;
+    {
+        std::lock_guard<std::mutex> lock(central.mutex);
+        while (fetched < count && central.list.count > 0)
+        {
+            list->push(central.list.pop());
+            ++fetched;
+        }
+    }
+    g_centralCachedBytes.fetch_sub(fetched * classSize(index), std::memory_order_relaxed);
+}
+
+class ThreadCache;
+
+std::mutex g_cachesMutex;
+std::vector<ThreadCache *> g_caches; ///< 所有线程缓存，只用来统计
+
+class ThreadCache
+{
+public:
+    ThreadCache() : cachedBytes_(0)
+    {
+        std::lock_guard<std::mutex> lock(g_cachesMutex);
+        g_caches.push_back(this);
+    }
+
+    // 线程退出，缓存全部还给中心链表
+    ~ThreadCache()
+    {
+        for (int i = 0; i < kNumClasses; ++i)
+        {
+            releaseToCentral(i, &lists_[i], lists_[i].count);
+        }
+        std::lock_guard<std::mutex> lock(g_cachesMutex);
+        g_caches.erase(std::find(g_caches.begin(), g_caches.end(), this));
+    }
+
+    void *allocate(int index)
+    {
+        FreeList &list = lists_[index];
+        if (list.count == 0)
+        {
+            fetchFromCentral(index, &list, threadCacheLimit(index) / 2);
+            if (list.count == 0)
+            {
+                return mallocBlock(index);
+            }
+            addCachedBytes(list.count * classSize(index));
+        }
+        addCachedBytes(-static_cast<ptrdiff_t>(classSize(index)));
+        return list.pop();
+    }
+
+    void deallocate(void *p, int index)
+    {
+        FreeList &list = lists_[index];
+        list.push(static_cast<FreeBlock *>(p));
+        addCachedBytes(classSize(index));
+        if (list.count > threadCacheLimit(index))
+        {
+            size_t count = list.count / 2;
+            releaseToCentral(index, &list, count);
+            addCachedBytes(-static_cast<ptrdiff_t>(count * classSize(index)));
+        }
+    }
+
+    size_t cachedBytes() const { return cachedBytes_.load(std::memory_order_relaxed); }
+
+private:
+    // 只有所属线程修改，统计时其他线程读取
+    void addCachedBytes(ptrdiff_t delta)
+    {
+        cachedBytes_.store(cachedBytes_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    FreeList lists_[kNumClasses];
+    std::atomic<size_t> cachedBytes_;
+};
+
+// 线程退出时析构的线程缓存，析构之后该线程再分配/释放直接使用中心链表
+__thread ThreadCache *t_cache = nullptr;
+__thread bool t_cacheDestroyed = false;
+
+struct ThreadCacheHolder
+{
+    ~ThreadCacheHolder()
+    {
+        t_cacheDestroyed = true;
+        delete t_cache;
+        t_cache = nullptr;
+    }
+};
+
+ThreadCache *threadCache()
+{
+    if (t_cache == nullptr && !t_cacheDestroyed)
+    {
+        static thread_local ThreadCacheHolder holder;
+        (void)holder;
+        t_cache = new ThreadCache;
+    }
+    return t_cache;
+}
+
+} // namespace
+
+void *BufferAllocator::allocate(size_t size, size_t *actualSize)
+{
+    if (size > kMaxClassSize)
+    {
+        void *p = ::malloc(size);
+        if (p == nullptr)
+        {
+            LOG_FATAL("BufferAllocator malloc %zu bytes failed\n", size);
+        }
+        *actualSize = size;
+        return p;
+    }
+
+    int index = classIndex(size);
+    *actualSize = classSize(index);
+    ThreadCache *cache = threadCache();
+    if (cache != nullptr)
+    {
+        return cache->allocate(index);
+    }
+
+    FreeList list;
+    fetchFromCentral(index, &list, 1);
+    return list.count > 0 ? list.pop() : mallocBlock(index);
+}
+
+size_t BufferAllocator::allocationSize(size_t size)
+{
+    return size > kMaxClassSize ? size : classSize(classIndex(size));
+}
+
+void BufferAllocator::deallocate(void *p, size_t actualSize)
+{
+    if (actualSize > kMaxClassSize)
+    {
+        ::free(p);
+        return;
+    }
+
+    int index = classIndex(actualSize);
+    ThreadCache *cache = threadCache();
+    if (cache != nullptr)
+    {
+        cache->deallocate(p, index);
+        return;
+    }
+
+    FreeList list;
+    list.push(static_cast<FreeBlock *>(p));
+    releaseToCentral(index, &list, 1);
+}
+
+BufferAllocator::Stats BufferAllocator::stats()
+{
+    Stats stats;
+    stats.reservedBytes = g_reservedBytes.load(std::memory_order_relaxed);
+    stats.cachedBytes = g_centralCachedBytes.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(g_cachesMutex);
+    for (ThreadCache *cache : g_caches)
+    {
+        stats.cachedBytes += cache->cachedBytes();
+    }
+    return stats;
+}
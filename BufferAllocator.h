@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Buffer和ChainBuffer数据块使用的内存分配器，TcpServer也用它复用连接对象的内存
+ * 按2的幂分成大小类：64, 128 ... 64K，更大的直接走malloc
+ *
+ * 线程本地缓存 => 每个大小类一个空闲链表，分配和释放都不加锁
+ * 中心链表     => 每个大小类一个，加锁；线程缓存空了从这里批量取，超过上限时批量放回这里
+ * 中心链表也超过上限时，多出来的块直接free，池子占用的内存有上界
+ *
+ * 跨线程释放：块可以在任意线程释放，放进释放线程的缓存，溢出后经中心链表流回分配线程，
+ * 一个线程只分配、另一个线程只释放也不会无限堆积；线程退出时缓存整体还给中心链表
+ *
+ * 释放时由调用者提供分配时得到的大小（Buffer本来就记录容量），块上不需要额外的头部
+ */
+class BufferAllocator
+{
+public:
+    static const size_t kMinClassSize = 64;
+    static const size_t kMaxClassSize = 64 * 1024;
+
+    // 至少size字节，*actualSize返回实际可用的大小（向上取整到大小类），调用者可以用满
+    static void *allocate(size_t size, size_t *actualSize);
+    // actualSize必须是allocate返回的大小
+    static void deallocate(void *p, size_t actualSize);
+    // allocate(size)会返回的actualSize，给没有记录容量的调用者释放时使用
+    static size_t allocationSize(size_t size);
+
+    struct Stats
+    {
+        size_t reservedBytes; ///< 池子向malloc申请、还没有free的内存（不包括大于kMaxClassSize的）
+        size_t cachedBytes;   ///< 其中空闲的部分（线程缓存 + 中心链表）
+    };
+    // 统计，线程安全，各线程缓存的数据是近似值
+    static Stats stats();
+};
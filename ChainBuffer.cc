@@ -0,0 +1,111 @@
+#include "ChainBuffer.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+ChainBuffer::ChainBuffer(const std::shared_ptr<ChunkPool> &pool)
+    : pool_(pool)
+    , head_(nullptr)
+    , tail_(nullptr)
+    , readableBytes_(0)
+    , numChunks_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    retrieveAll();
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    readableBytes_ += len;
+    while (len > 0)
+    {
+        if (tail_ == nullptr || tail_->writableBytes() == 0)
+        {
+            Chunk *chunk = pool_->allocate();
+            if (tail_ == nullptr)
+            {
+                head_ = chunk;
+            }
+            else
+            {
+                tail_->next = chunk;
+            }
+            tail_ = chunk;
+            ++numChunks_;
+        }
+
+        size_t n = std::min(len, tail_->writableBytes());
+        memcpy(tail_->data + tail_->writeIndex, data, n);
+        tail_->writeIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    if (len >= readableBytes_)
+    {
+        retrieveAll();
+        return;
+    }
+
+    readableBytes_ -= len;
+    while (len > 0)
+    {
+        size_t n = std::min(len, head_->readableBytes());
+        head_->readIndex += n;
+        len -= n;
+        // 最后一个块即使读完也留着，后面的append可以接着写
+        if (head_->readableBytes() == 0 && head_ != tail_)
+        {
+            Chunk *next = head_->next;
+            pool_->deallocate(head_);
+            head_ = next;
+            --numChunks_;
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    while (head_ != nullptr)
+    {
+        Chunk *next = head_->next;
+        pool_->deallocate(head_);
+        head_ = next;
+    }
+    tail_ = nullptr;
+    readableBytes_ = 0;
+    numChunks_ = 0;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *savedErrno, size_t maxBytes)
+{
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (Chunk *chunk = head_; chunk != nullptr && iovcnt < IOV_MAX && maxBytes > 0; chunk = chunk->next)
+    {
+        if (chunk->readableBytes() > 0)
+        {
+            size_t len = std::min(chunk->readableBytes(), maxBytes);
+            vec[iovcnt].iov_base = chunk->data + chunk->readIndex;
+            vec[iovcnt].iov_len = len;
+            maxBytes -= len;
+            ++iovcnt;
+        }
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    return n;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "ChunkPool.h"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * 分块的发送缓冲区，数据存放在一串定长块中
+ *
+ * head_ -> [readIndex ... writeIndex] -> [...] -> tail_ -> nullptr
+ *
+ * 和Buffer相比：
+ * append只在链表尾部追加块，已有的数据不会因为扩容被拷贝，也没有makeSpace的memmove
+ * writeFd用writev一次发送最多IOV_MAX个块
+ * retrieve把发送完的块直接还给内存池
+ *
+ * 块来自所属EventLoop的ChunkPool，只能在loop线程中使用；持有内存池的shared_ptr，
+ * 连接比loop晚析构时也不会访问已经释放的内存池
+ */
+class ChainBuffer : noncopyable
+{
+public:
+    explicit ChainBuffer(const std::shared_ptr<ChunkPool> &pool);
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return readableBytes_; }
+    size_t numChunks() const { return numChunks_; }
+
+    // 把[data, data + len]内存上的数据追加到链表尾部
+    void append(const char *data, size_t len);
+
+    void retrieve(size_t len);
+    // 清空数据，所有块还给内存池
+    void retrieveAll();
+
+    // 通过fd发送数据，writev最多IOV_MAX个块、最多maxBytes字节，和Buffer::writeFd一样由调用者retrieve
+    ssize_t writeFd(int fd, int *savedErrno, size_t maxBytes = SIZE_MAX);
+
+private:
+    using Chunk = ChunkPool::Chunk;
+
+    std::shared_ptr<ChunkPool> pool_;
+    Chunk *head_;
+    Chunk *tail_;
+    size_t readableBytes_;
+    size_t numChunks_;
+};
@@ -13,7 +13,8 @@ Channel::Channel(EventLoop *loop, int fd)
     , fd_(fd)
     , event_(0)
     , revent_(0)
-    , index_(-1)
+    , addedToLoop_(false)
+    , edgeTriggered_(false)
     , tied_(false)
 {
 }
@@ -36,12 +37,32 @@ void Channel::tie(const std::shared_ptr<void> &obj)
 void Channel::update()
 {
     // 通过channel所属的EventLoop，调用Poller的相关方法，注册fd的相关事件
+    addedToLoop_ = true;
     loop_->updateChannel(this);
 }
 
+void Channel::updateIfChanged(int oldPollEvents)
+{
+    // Channel还没有添加到poller中时，也要走一遍update
+    if (pollEvents() != oldPollEvents || !addedToLoop_)
+    {
+        update();
+    }
+}
+
+int Channel::pollEvents() const
+{
+    if (edgeTriggered_ && event_ != kNoneEvent)
+    {
+        return event_ | kWriteEvent | EPOLLET;
+    }
+    return event_;
+}
+
 // 在Channel所属的EventLoop中，把当前的channel删除
 void Channel::remove()
 {
+    addedToLoop_ = false;
     loop_->removeChannel(this);
 }
 
@@ -65,7 +86,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 根据Poller通知Channel发生的具体事件，由Channel负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents : %d\n", revent_);
+    LOG_DEBUG("channel handleEvent revents : %d\n", revent_);
 
     if ((revent_ & EPOLLHUP) && !(revent_ & EPOLLIN))
     {
@@ -91,7 +112,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
         }
     }
 
-    if (revent_ & EPOLLOUT)
+    // ET模式下EPOLLOUT一直注册着，没有数据要写的时候也会上报
+    if ((revent_ & EPOLLOUT) && (!edgeTriggered_ || isWriting()))
     {
         if (writeCallback_)
         {
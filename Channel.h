@@ -36,13 +36,24 @@ public:
 
     int fd() const { return fd_; }
     int events() const { return event_; }
-    int set_revent(int revt) { revent_ = revt; }
-
-    // 设置fd相应的事件状态
-    void enableReading() { event_ |= kReadEvent; update(); }
-    void disableReading() { event_ &= ~kReadEvent; update(); }
-    void enableWriting() { event_ |= kWriteEvent; update(); }
-    void disableWriting() { event_ &= ~kWriteEvent; update(); }
+    void set_revent(int revt) { revent_ = revt; }
+    int revent() const { return revent_; }
+
+    /**
+     * 边沿触发模式，必须在第一次enable之前设置
+     * ET模式下只要Channel在poller中，EPOLLOUT就一直注册着，enableWriting/disableWriting只修改event_，不调用epoll_ctl
+     * 用户需要一直读（写）到EAGAIN
+     */
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool isEdgeTriggered() const { return edgeTriggered_; }
+    // 实际注册到poller中的事件
+    int pollEvents() const;
+
+    // 设置fd相应的事件状态，注册到poller中的事件没有变化时，不会调用epoll_ctl
+    void enableReading() { int old = pollEvents(); event_ |= kReadEvent; updateIfChanged(old); }
+    void disableReading() { int old = pollEvents(); event_ &= ~kReadEvent; updateIfChanged(old); }
+    void enableWriting() { int old = pollEvents(); event_ |= kWriteEvent; updateIfChanged(old); }
+    void disableWriting() { int old = pollEvents(); event_ &= ~kWriteEvent; updateIfChanged(old); }
     void disableAll() { event_ = kNoneEvent; update(); }
 
     // 返回fd当前的事件状态
@@ -50,9 +61,6 @@ public:
     bool isReading() const { return event_ & kReadEvent; }
     bool isWriting() const { return event_ & kWriteEvent; }
 
-    int index() { return index_; }
-    void set_index(int idx) { index_ = idx; }
-
     // one loop per thread
     EventLoop* ownerLoop() { return loop_; }
     void remove();
@@ -60,6 +68,7 @@ public:
 private:
 
     void update();
+    void updateIfChanged(int oldPollEvents);
     void handleEventWithGuard(Timestamp receiveTime);
 
     static const int kNoneEvent;
@@ -70,7 +79,8 @@ private:
     const int fd_;    ///< poller监听的对象
     int event_;       ///< 注册fd感兴趣的事件
     int revent_;      ///< poller返回具体发生的事件
-    int index_;
+    bool addedToLoop_; ///< 注册状态由Poller的fd表维护，这里只记录是否调用过update
+    bool edgeTriggered_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
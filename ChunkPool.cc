@@ -0,0 +1,25 @@
+#include "ChunkPool.h"
+#include "BufferAllocator.h"
+
+ChunkPool::ChunkPool()
+    : chunksInUse_(0)
+{
+}
+
+ChunkPool::Chunk *ChunkPool::allocate()
+{
+    size_t actualSize = 0;
+    Chunk *chunk = static_cast<Chunk *>(BufferAllocator::allocate(kChunkSize, &actualSize));
+    chunksInUse_.store(chunksInUse_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    chunk->next = nullptr;
+    chunk->readIndex = 0;
+    chunk->writeIndex = 0;
+    return chunk;
+}
+
+void ChunkPool::deallocate(Chunk *chunk)
+{
+    BufferAllocator::deallocate(chunk, kChunkSize);
+    chunksInUse_.store(chunksInUse_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+
+/**
+ * 每个EventLoop一个，给ChainBuffer提供定长数据块
+ * 块的内存来自BufferAllocator的kChunkSize大小类（loop线程的线程缓存），空闲块的缓存和归还都由分配器负责
+ * 这里只统计本loop的发送缓冲区用了多少块
+ * 只能在所属loop的线程中使用；统计数据可以在任意线程读取
+ */
+class ChunkPool : noncopyable
+{
+public:
+    static const size_t kChunkSize = 16 * 1024; ///< 包括块头在内的大小，正好是一个大小类
+
+    struct Chunk
+    {
+        Chunk *next;
+        size_t readIndex;
+        size_t writeIndex;
+        char data[1]; ///< 实际长度是kChunkDataSize
+
+        size_t readableBytes() const { return writeIndex - readIndex; }
+        size_t writableBytes() const;
+    };
+
+    static const size_t kChunkDataSize = kChunkSize - offsetof(Chunk, data);
+
+    ChunkPool();
+
+    // 取一个空块，readIndex和writeIndex都为0
+    Chunk *allocate();
+    void deallocate(Chunk *chunk);
+
+    // 统计：正在使用的块占用的内存
+    size_t inUseBytes() const { return chunksInUse_.load(std::memory_order_relaxed) * kChunkSize; }
+
+private:
+    std::atomic<size_t> chunksInUse_; ///< 只在loop线程中修改，其他线程只读
+};
+
+inline size_t ChunkPool::Chunk::writableBytes() const
+{
+    return kChunkDataSize - writeIndex;
+}
@@ -1,5 +1,7 @@
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 #include <stdlib.h>
 
@@ -9,8 +11,20 @@ Poller *Poller::newDefaultPoller(EventLoop *loop)
     {
         return nullptr; // 生成poll的实例
     }
+    else if (::getenv("MUDUO_USE_IO_URING"))
+    {
+        // 内核不支持（或者被seccomp禁用）时退回epoll
+        IoUringPoller *poller = new IoUringPoller(loop);
+        if (poller->valid())
+        {
+            return poller;
+        }
+        delete poller;
+        LOG_ERROR("io_uring is not supported, fall back to epoll\n");
+        return new EPollPoller(loop);
+    }
     else
     {
         return new EPollPoller(loop); // 生成epoll的实例
     }
-}
\ No newline at end of file
+}
@@ -6,14 +6,6 @@
 #include <unistd.h>
 #include <string.h>
 
-// 状态
-// channel未添加到poller中
-const int kNew = -1; ///< channel的成员index_初始化为-1
-// channel已添加到poller中
-const int kAdded = 1;
-// channel从poller中删除
-const int kDeleted = 2;
-
 EPollPoller::EPollPoller(EventLoop *loop)
     : Poller(loop), epollfd_(::epoll_create1(EPOLL_CLOEXEC)), events_(kInitEventListSize)
 {
@@ -30,15 +22,14 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    // 实际上用LOG_DEBUG输出日志更为合理
-    LOG_INFO("func=%s => fd total count:%d\n", __FUNCTION__, channels_.size());
+    LOG_DEBUG("func=%s => fd total count:%zu\n", __FUNCTION__, numChannels());
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
     Timestamp now(Timestamp::now());
 
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happened\n", numEvents);
+        LOG_DEBUG("%d events happened\n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size())
         {
@@ -64,31 +55,29 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 /**
  *          EventLoop
  *  ChannelList        Poller
- *                   ChannelMap <fd, Channel>
+ *                   ChannelTable [fd] => {Channel, state}
  */
 void EPollPoller::updateChannel(Channel *channel)
 {
-    const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d event=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), channel->index());
+    ChannelEntry &e = entry(channel->fd());
+    LOG_DEBUG("func=%s => fd=%d event=%d state=%d\n", __FUNCTION__, channel->fd(), channel->events(), e.state);
 
-    if (index == kNew || index == kDeleted)
+    if (e.state == kNew || e.state == kDeleted)
     {
-        if (index == kNew)
+        if (e.state == kNew)
         {
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            addChannel(e, channel);
         }
 
-        channel->set_index(kAdded);
+        e.state = kAdded;
         update(EPOLL_CTL_ADD, channel);
     }
     else // channel已经在poller注册过了
     {
-        int fd = channel->fd();
         if (channel->isNoneEvent())
         {
             update(EPOLL_CTL_DEL, channel);
-            channel->set_index(kDeleted);
+            e.state = kDeleted;
         }
         else
         {
@@ -101,16 +90,14 @@ void EPollPoller::updateChannel(Channel *channel)
 void EPollPoller::removeChannel(Channel *channel)
 {
     int fd = channel->fd();
-    channels_.erase(fd);
-
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
 
-    int index = channel->index();
-    if (index == kAdded)
+    ChannelEntry &e = entry(fd);
+    if (e.state == kAdded)
     {
         update(EPOLL_CTL_DEL, channel);
     }
-    channel->set_index(kNew);
+    eraseChannel(e);
 }
 
 // 填写活跃连接
@@ -132,7 +119,7 @@ void EPollPoller::update(int operation, Channel *channel)
 
     int fd = channel->fd();
 
-    event.events = channel->events();
+    event.events = channel->pollEvents();
     event.data.ptr = channel;
 
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
@@ -2,6 +2,9 @@
 #include "Logger.h"
 #include "Channel.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "ChunkPool.h"
+#include "PipePool.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -32,8 +35,16 @@ EventLoop::EventLoop()
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
+    , chunkPool_(std::make_shared<ChunkPool>())
+    , recvArena_(new char[kRecvArenaSize])
+    , pipePool_(new PipePool)
+    , inputBufferBytes_(0)
     , wakeupFd_(createEventFd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , wakeupPending_(false)
+    , wakeupsWritten_(0)
+    , wakeupsSaved_(0)
     , currentActiveChannel_(nullptr)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
@@ -66,13 +77,25 @@ void EventLoop::handleRead()
     ssize_t n = read(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
     {
-        LOG_ERROR("EventLoop::handleRead() reads %d bytes instead of 8\n", n);
+        LOG_ERROR("EventLoop::handleRead() reads %zd bytes instead of 8\n", n);
+    }
+    else
+    {
+        // eventfd读出来的是这段时间内所有write的累加值
+        wakeupsWritten_.store(wakeupsWritten_.load(std::memory_order_relaxed) + one, std::memory_order_relaxed);
     }
 }
 
 // 用来唤醒loop所在的线程，向wakeupFd写一个数据，wakeupChannel发生读事件，当前loop线程就会被唤醒
 void EventLoop::wakeup()
 {
+    // loop已经被唤醒，并且还没有开始执行这一轮的doPendingFunctors，不需要再写
+    if (wakeupPending_.exchange(true, std::memory_order_acq_rel))
+    {
+        wakeupsSaved_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
@@ -94,12 +117,19 @@ void EventLoop::loop()
         activeChannels_.clear();
         // 如果是subLoop，监听两类fd：（1）client的fd   （2）wakeupFd
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        pollReturnMonotonicTime_ = Timestamp::coarseMonotonicNow();
+        // 接下来一定会执行doPendingFunctors
+        // 用exchange而不是store：普通store会打断生产者exchange形成的release序列，
+        // doPendingFunctors里的exchange(false)读到这里的值时就和跳过写操作的生产者同步不上
+        wakeupPending_.exchange(true, std::memory_order_acq_rel);
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些Channel发生事件了，上报给EventLoop，通知Channel处理相应的事件
             currentActiveChannel_ = channel;
             channel->handleEvent(pollReturnTime_);
         }
+        // 这一轮事件处理中攒下的发送，发送完成的回调放进pendingFunctors，下面就会执行
+        doFlushFunctors();
         // 执行当前EventLoop事件循环需要处理的回调操作
         /**
          * mainLoop：accept新连接 => fd（封装成channel）交给subLoop
@@ -136,17 +166,14 @@ void EventLoop::runInLoop(Functor cb)
     }
     else                    // 在非当前loop线程中执行，Loop_1中：Loop_2.runInLoop(cb)，就需要唤醒mainLoop所在线程
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
-    }
+    pendingFunctors_.push(std::move(cb));
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
     // 这里的||callingPendingFunctors_需要好好想想：当前的loop正在执行回调，这时又向里面添加了新的functor
@@ -157,6 +184,38 @@ void EventLoop::queueInLoop(Functor cb)
     }
 }
 
+void EventLoop::queueFlush(Functor cb)
+{
+    flushFunctors_.push_back(std::move(cb));
+    // 在pendingFunctors中调用的，本轮已经过了flush的时机，让下一轮poll立即返回
+    if (callingPendingFunctors_)
+    {
+        wakeup();
+    }
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 调用Poller的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -173,20 +232,27 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
+void EventLoop::doFlushFunctors()
+{
+    // 执行过程中新加入的也在这里执行；flushFunctors_的容量保留下来，每轮不用重新分配
+    for (size_t i = 0; i < flushFunctors_.size(); ++i)
+    {
+        Functor cb(std::move(flushFunctors_[i]));
+        cb();
+    }
+    flushFunctors_.clear();
+}
+
 // 执行回调
 void EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
+    // 从这里开始的wakeup都要真正写wakeupFd，否则下一轮poll会阻塞
+    // 用exchange而不是store，和跳过写操作的生产者同步，保证能看到它们入队的回调
+    wakeupPending_.exchange(false, std::memory_order_acq_rel);
 
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
-    }
-
-    for (const Functor& functor : functors)
-    {
-        functor();  // 执行当前loop需要执行的回调操作
-    }
+    // 只执行到进入时最后入队的那个回调为止，执行过程中新加入的回调留到下一轮（queueInLoop会wakeup）
+    // 否则回调里不断queueInLoop会让loop一直停留在这里
+    pendingFunctors_.consume([](Functor &cb) { cb(); }); // 执行当前loop需要执行的回调操作
     callingPendingFunctors_ = false;
 }
\ No newline at end of file
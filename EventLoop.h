@@ -3,21 +3,27 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Task.h"
 
 #include <functional>
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 class Channel;
 class Poller;
+class TimerQueue;
+class ChunkPool;
+class PipePool;
 
 // 事件循环类 主要包含了两个大模块：Channel   Poller（epoll的抽象）
 class EventLoop : noncopyable
 {
 public:
-    using Functor = std::function<void()>;
+    using Functor = Task; ///< 只能移动，小对象不分配内存
 
     EventLoop();
     ~EventLoop();
@@ -27,27 +33,64 @@ public:
     // 退出事件循环
     void quit();
 
+    // 每轮poll返回时缓存一次的时间，回调里需要当前时间时直接用，不用再取系统时间
     Timestamp pollReturnTime() const { return pollReturnTime_; }
+    Timestamp pollReturnMonotonicTime() const { return pollReturnMonotonicTime_; }
 
     // 在当前loop中执行cb
     void runInLoop(Functor cb);
     // 把cb放入队列中，唤醒loop所在的线程，执行cb
     void queueInLoop(Functor cb);
 
+    // 只能在loop线程中调用：cb在本轮处理完活跃Channel之后、执行pendingFunctors之前执行
+    // 用来把一轮事件处理中的多次发送合并成一次，见TcpConnection::setCorked
+    void queueFlush(Functor cb);
+
     // 用来唤醒loop所在的线程
     void wakeup();
 
+    // 统计：实际写wakeupFd的次数，以及因为loop已经被唤醒而省掉的次数
+    int64_t wakeupsWritten() const { return wakeupsWritten_.load(std::memory_order_relaxed); }
+    int64_t wakeupsSaved() const { return wakeupsSaved_.load(std::memory_order_relaxed); }
+
+    // 定时器，线程安全
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒之后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
     // 调用Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
 
+    // 本loop的发送缓冲区数据块内存池，只能在loop线程中使用
+    const std::shared_ptr<ChunkPool> &chunkPool() const { return chunkPool_; }
+    // 本loop所有连接共用的接收溢出区，Buffer::readFd的可写空间不够时先读到这里，只能在loop线程中使用
+    char *recvArena() const { return recvArena_.get(); }
+    static const size_t kRecvArenaSize = 64 * 1024;
+    // 本loop中splice转发用的管道池，只能在loop线程中使用
+    PipePool *pipePool() const { return pipePool_.get(); }
+
+    // 统计：本loop中所有连接inputBuffer占用的内存，由TcpConnection在loop线程中更新，可以在任意线程读取
+    // 发送缓冲区的内存见chunkPool()的inUseBytes，分配器整体的占用见BufferAllocator::stats
+    void addInputBufferBytes(int64_t delta)
+    {
+        inputBufferBytes_.store(inputBufferBytes_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    int64_t inputBufferBytes() const { return inputBufferBytes_.load(std::memory_order_relaxed); }
+
     // 判断EventLoop对象是否在自己的线程里
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
 private:
     void handleRead();        // wakeup
     void doPendingFunctors(); // 执行回调
+    void doFlushFunctors();
 
     using ChannelList = std::vector<Channel *>;
 
@@ -56,17 +99,31 @@ private:
 
     const pid_t threadId_; ///< 当前loop所在线程的id
 
-    Timestamp pollReturnTime_; ///< poller返回发生事件Channel的时间点
+    Timestamp pollReturnTime_;          ///< poller返回发生事件Channel的时间点
+    Timestamp pollReturnMonotonicTime_; ///< 同上，CLOCK_MONOTONIC_COARSE，用来计算时间差
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_; ///< 依赖poller_注册timerfd，必须在poller_之后构造
+    std::shared_ptr<ChunkPool> chunkPool_;   ///< TcpConnection的ChainBuffer也持有，连接可能比loop晚析构
+    std::unique_ptr<char[]> recvArena_;      ///< 不清零，每次读只用readv实际写入的部分
+    std::unique_ptr<PipePool> pipePool_;     ///< 连接在connectDestroyed中归还管道，不会比loop晚
+    std::atomic<int64_t> inputBufferBytes_;
 
     // one loop per thread: loop之间的通信机制
     int wakeupFd_; ///< 当mainLoop收到一个新用户的Channel，通过轮询算法选择一个subLoop，通过该成员唤醒subLoop处理（统一事件源）
     std::unique_ptr<Channel> wakeupChannel_;
+    /**
+     * wakeup合并：为true表示loop已经被唤醒（或者正在处理活跃Channel），一定会执行doPendingFunctors
+     * 这期间的wakeup不用再写wakeupFd，连续投递1000个回调只需要写一次
+     * poll返回后置为true，doPendingFunctors开始前置为false
+     */
+    std::atomic_bool wakeupPending_;
+    std::atomic<int64_t> wakeupsWritten_; ///< 只在loop线程中累加，由eventfd读出的计数得到
+    std::atomic<int64_t> wakeupsSaved_;
 
     ChannelList activeChannels_;
     Channel *currentActiveChannel_;
 
     std::atomic_bool callingPendingFunctors_; ///< 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;    ///< 存储loop需要执行的所有回调操作
-    std::mutex mutex_;                         ///< 互斥锁，用来保护上面vector容器的线程安全操作
+    MpscQueue<Functor> pendingFunctors_;      ///< 存储loop需要执行的所有回调操作，无锁，其他线程直接入队
+    std::vector<Functor> flushFunctors_;      ///< 本轮有数据待发送的连接，只在loop线程中访问
 };
\ No newline at end of file
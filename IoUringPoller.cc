@@ -0,0 +1,379 @@
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int ioUringSetup(unsigned entries, io_uring_params *p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argsz)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz));
+}
+
+static unsigned loadAcquire(const unsigned *p)
+{
+    return reinterpret_cast<const std::atomic<unsigned> *>(p)->load(std::memory_order_acquire);
+}
+
+static void storeRelease(unsigned *p, unsigned v)
+{
+    reinterpret_cast<std::atomic<unsigned> *>(p)->store(v, std::memory_order_release);
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , features_(0)
+    , sqRing_(MAP_FAILED)
+    , sqRingSize_(0)
+    , sqes_(nullptr)
+    , sqesSize_(0)
+    , sqEntries_(0)
+    , sqeTail_(0)
+    , toSubmit_(0)
+    , cqRing_(MAP_FAILED)
+    , cqRingSize_(0)
+    , round_(0)
+{
+    if (!setupRing())
+    {
+        LOG_ERROR("io_uring setup error : %d\n", errno);
+        if (ringFd_ >= 0)
+        {
+            ::close(ringFd_);
+            ringFd_ = -1;
+        }
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (ringFd_ >= 0 && toSubmit_ > 0)
+    {
+        submit();
+    }
+    if (sqes_ != nullptr)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+    }
+}
+
+bool IoUringPoller::setupRing()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    ringFd_ = ioUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0)
+    {
+        return false;
+    }
+
+    // 需要：带超时的等待（5.11）、multishot poll（5.13，和RSRC_TAGS同一个版本）
+    features_ = params.features;
+    if (!(features_ & IORING_FEAT_EXT_ARG) || !(features_ & IORING_FEAT_RSRC_TAGS))
+    {
+        errno = ENOSYS;
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            return false;
+        }
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    char *cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+IoUringPoller::FdState &IoUringPoller::state(int fd)
+{
+    if (static_cast<size_t>(fd) >= fdStates_.size())
+    {
+        fdStates_.resize(fd * 2 + 1);
+    }
+    return fdStates_[fd];
+}
+
+// 取一个空闲的提交项，提交队列满了就先提交一次（不等待）
+io_uring_sqe *IoUringPoller::getSqe()
+{
+    if (sqeTail_ - loadAcquire(sqHead_) >= sqEntries_)
+    {
+        submit();
+    }
+
+    unsigned index = sqeTail_ & *sqMask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqeTail_;
+    ++toSubmit_;
+    return sqe;
+}
+
+void IoUringPoller::arm(Channel *channel)
+{
+    int fd = channel->fd();
+    FdState &st = state(fd);
+    ++st.generation;
+    st.armed = true;
+    st.multishot = channel->isEdgeTriggered();
+
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // EPOLLIN/EPOLLOUT等和POLLIN/POLLOUT的值相同，EPOLLET由multishot代替
+    sqe->poll32_events = static_cast<uint32_t>(channel->pollEvents()) & ~static_cast<uint32_t>(EPOLLET);
+    sqe->len = st.multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, st.generation);
+}
+
+void IoUringPoller::disarm(int fd)
+{
+    FdState &st = state(fd);
+    if (!st.armed)
+    {
+        return;
+    }
+
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, st.generation);
+    sqe->user_data = 0; ///< 删除操作自己的完成事件直接忽略
+    if (features_ & IORING_FEAT_CQE_SKIP)
+    {
+        sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    }
+    // 之后收到的旧请求的完成事件都会因为generation不匹配被忽略
+    ++st.generation;
+    st.armed = false;
+}
+
+// 只提交不等待
+void IoUringPoller::submit()
+{
+    storeRelease(sqTail_, sqeTail_);
+    int ret = ioUringEnter(ringFd_, toSubmit_, 0, 0, nullptr, 0);
+    if (ret < 0)
+    {
+        LOG_FATAL("io_uring_enter submit error : %d\n", errno);
+    }
+    toSubmit_ -= ret;
+}
+
+int IoUringPoller::submitAndWait(int timeoutMs)
+{
+    storeRelease(sqTail_, sqeTail_);
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000 * 1000;
+
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof arg);
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int ret = ioUringEnter(ringFd_, toSubmit_, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof arg);
+    if (ret >= 0)
+    {
+        toSubmit_ -= ret;
+    }
+    return ret;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    // 上一轮上报过的LT Channel，回调执行完之后再重新注册，回调里修改过事件的已经注册过了
+    for (int fd : rearmFds_)
+    {
+        const ChannelEntry &e = entry(fd);
+        if (e.channel != nullptr && e.state == kAdded && !state(fd).armed && !e.channel->isNoneEvent())
+        {
+            arm(e.channel);
+        }
+    }
+    rearmFds_.clear();
+
+    int ret = submitAndWait(timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll error!\n");
+    }
+    fillActiveChannels(activeChannels);
+    return now;
+}
+
+// 收割完成队列，同一个fd在一轮中的多个完成事件合并成一次
+void IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    ++round_;
+    unsigned head = *cqHead_;
+    unsigned tail = loadAcquire(cqTail_);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+        if (cqe.user_data == 0)
+        {
+            continue;
+        }
+
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+        FdState &st = state(fd);
+        Channel *channel = findChannel(fd);
+        if (generation != st.generation || channel == nullptr)
+        {
+            continue; // 已经被删除或者重新注册过了
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+        {
+            // 一次性的poll，或者multishot被内核终止了，下一轮poll时重新注册
+            st.armed = false;
+        }
+
+        if (cqe.res < 0)
+        {
+            if (cqe.res != -ECANCELED)
+            {
+                LOG_ERROR("io_uring poll fd=%d error : %d\n", fd, -cqe.res);
+            }
+        }
+        else if (st.activeRound == round_)
+        {
+            channel->set_revent(channel->revent() | cqe.res);
+        }
+        else
+        {
+            st.activeRound = round_;
+            channel->set_revent(cqe.res);
+            activeChannels->push_back(channel);
+        }
+
+        if (!st.armed)
+        {
+            rearmFds_.push_back(fd);
+        }
+    }
+    storeRelease(cqHead_, head);
+}
+
+// 调用链：channel(update) -> EventLoop(updateChannel) -> Poller(updateChannel)
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    ChannelEntry &e = entry(fd);
+    LOG_DEBUG("func=%s => fd=%d event=%d state=%d\n", __FUNCTION__, fd, channel->events(), e.state);
+
+    if (e.state == kNew || e.state == kDeleted)
+    {
+        if (e.state == kNew)
+        {
+            addChannel(e, channel);
+        }
+        e.state = kAdded;
+        disarm(fd);
+        arm(channel);
+    }
+    else // channel已经在poller注册过了
+    {
+        disarm(fd);
+        if (channel->isNoneEvent())
+        {
+            e.state = kDeleted;
+        }
+        else
+        {
+            arm(channel);
+        }
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+    // 调用者接下来就会close(fd)，内核中的poll请求持有文件的引用，必须马上提交删除，
+    // 否则socket要等到下一次poll才真正关闭（监听socket还会留在SO_REUSEPORT组里继续接收连接）
+    if (state(fd).armed)
+    {
+        disarm(fd);
+        submit();
+    }
+    eraseChannel(entry(fd));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+class Channel;
+
+/**
+ * io_uring的使用（不依赖liburing，直接使用系统调用）
+ * io_uring_setup + mmap => 构造函数
+ * updateChannel => 只往提交队列里写POLL_ADD/POLL_REMOVE，不进入内核
+ * removeChannel => 马上提交POLL_REMOVE，调用者随后会close(fd)
+ * poll => 一次io_uring_enter，把积攒的所有提交和等待事件合并成一次系统调用
+ *
+ * ET模式的Channel用multishot poll，注册一次之后一直上报，和EPOLLET的语义一致
+ * LT模式的Channel用一次性的poll，每次上报之后在下一次poll时重新注册（和提交一起批量完成），
+ * 注册时如果fd已经就绪会立刻上报，所以和EPOLL的LT语义一致
+ */
+class IoUringPoller : public Poller
+{
+public:
+    IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // 内核不支持io_uring（或者被禁用）时返回false，这时应该改用EPollPoller
+    bool valid() const { return ringFd_ >= 0; }
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+private:
+    static const unsigned kRingEntries = 1024;
+
+    // 每个fd的注册状态，按fd下标直接访问
+    struct FdState
+    {
+        FdState() : generation(0), armed(false), multishot(false), activeRound(0) {}
+
+        uint32_t generation; ///< 每次重新注册加一，区分已经失效的完成事件
+        bool armed;          ///< 内核中是否有这个fd的poll请求
+        bool multishot;
+        uint64_t activeRound; ///< 本轮poll是否已经加入activeChannels，防止重复
+    };
+
+    bool setupRing();
+    FdState &state(int fd);
+
+    io_uring_sqe *getSqe();
+    void arm(Channel *channel);
+    void disarm(int fd);
+    void submit();
+    int submitAndWait(int timeoutMs);
+    void fillActiveChannels(ChannelList *activeChannels);
+
+    static uint64_t makeUserData(int fd, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    int ringFd_;
+    unsigned features_;
+
+    // 提交队列
+    void *sqRing_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    unsigned sqEntries_;
+    unsigned sqeTail_;   ///< 本地的tail，提交时才写回共享内存
+    unsigned toSubmit_;
+
+    // 完成队列
+    void *cqRing_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    io_uring_cqe *cqes_;
+
+    std::vector<FdState> fdStates_;
+    std::vector<int> rearmFds_; ///< 需要在下一次poll时重新注册的fd
+    uint64_t round_;
+};
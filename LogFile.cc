@@ -0,0 +1,121 @@
+#include "LogFile.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len)
+{
+    if (fp_ == nullptr)
+    {
+        return;
+    }
+
+    size_t written = 0;
+    while (written != len)
+    {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if (n == 0)
+        {
+            int err = ::ferror(fp_);
+            if (err)
+            {
+                fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    if (writtenBytes_ > rollSize_)
+    {
+        rollFile();
+    }
+    else
+    {
+        time_t now = ::time(NULL);
+        if (now / kRollPerSeconds * kRollPerSeconds != startOfPeriod_)
+        {
+            rollFile();
+        }
+    }
+}
+
+void LogFile::flush()
+{
+    if (fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+void LogFile::rollFile()
+{
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    // 同一秒内不重复滚动，否则文件名相同
+    if (now <= lastRoll_)
+    {
+        return;
+    }
+
+    FILE *fp = ::fopen(filename.c_str(), "ae"); // 'e' : O_CLOEXEC
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "LogFile::rollFile() open %s failed: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof buffer_);
+
+    lastRoll_ = now;
+    startOfPeriod_ = now / kRollPerSeconds * kRollPerSeconds;
+    writtenBytes_ = 0;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
+{
+    std::string filename(basename);
+
+    char timebuf[32];
+    struct tm tm;
+    *now = ::time(NULL);
+    ::localtime_r(now, &tm);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256] = "unknownhost";
+    ::gethostname(hostname, sizeof hostname);
+    hostname[sizeof hostname - 1] = '\0';
+    filename += hostname;
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+
+    return filename;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ * 滚动日志文件，只由AsyncLogging的后端线程使用，所以不加锁
+ * 文件大小超过rollSize或者跨天时，新建一个日志文件
+ * 文件名：basename.20240101-120000.hostname.pid.log
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename, off_t rollSize);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    void rollFile();
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    static const int kRollPerSeconds = 60 * 60 * 24;
+    static const size_t kFileBufferSize = 64 * 1024;
+
+    const std::string basename_;
+    const off_t rollSize_;
+
+    FILE *fp_;
+    off_t writtenBytes_;
+    time_t startOfPeriod_; ///< 当前日志文件所属的那一天（0点）
+    time_t lastRoll_;
+    char buffer_[kFileBufferSize]; ///< 给FILE用的缓冲区
+};
@@ -1,7 +1,27 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+std::atomic_int Logger::logLevel_(MYMUDUO_MIN_LOG_LEVEL);
+
+static void defaultOutput(const char *msg, int len)
+{
+    fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    fflush(stdout);
+}
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
 
 // 获取日志唯一的实例对象
 Logger &Logger::instance()
@@ -10,31 +30,60 @@ Logger &Logger::instance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
-{
-    logLevel_ = level;
-}
-
 // 写日志 [级别信息] time : msg
-void Logger::log(std::string msg)
+// 直接在栈上拼好一整行，再一次性交给output_，多线程输出时行与行之间不会交错
+void Logger::log(int level, const char *format, ...)
 {
-    switch (logLevel_)
+    const char *levelStr = "";
+    switch (level)
     {
+    case DEBUG:
+        levelStr = "[DEBUG]";
+        break;
     case INFO:
-        std::cout << "[INFO]";
+        levelStr = "[INFO]";
         break;
     case ERROR:
-        std::cout << "[ERROR]";
+        levelStr = "[ERROR]";
+        break;
     case FATAL:
-        std::cout << "[FATAL]";
-    case DEBUG:
-        std::cout << "[DEBUG]";
+        levelStr = "[FATAL]";
+        break;
     default:
         break;
     }
 
     // 打印时间和msg
-    std::cout << Timestamp::now().toString()
-              << " : " << msg << std::endl;
-}
\ No newline at end of file
+    char timebuf[Timestamp::kFormattedSize];
+    Timestamp::now().formatTo(timebuf, false);
+
+    char line[1024 + 64];
+    int len = snprintf(line, sizeof line, "%s%s : ", levelStr, timebuf);
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line + len, sizeof line - len, format, args);
+    va_end(args);
+
+    if (n < 0)
+    {
+        n = 0;
+    }
+    len += n;
+    // 留一个字节给换行符，超长的日志截断
+    if (len > static_cast<int>(sizeof line) - 2)
+    {
+        len = sizeof line - 2;
+    }
+    // 调用方的格式串大多自带了换行
+    if (line[len - 1] != '\n')
+    {
+        line[len++] = '\n';
+    }
+    output_(line, len);
+
+    if (level == FATAL)
+    {
+        flush_();
+    }
+}
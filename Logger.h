@@ -1,62 +1,71 @@
 #pragma once
 
 #include <string>
+#include <atomic>
+#include <stdlib.h>
 
 #include "noncopyable.h"
 
+/**
+ * 日志级别过滤分两层：
+ * 编译期：MYMUDUO_MIN_LOG_LEVEL 以下的级别整条语句被编译器删掉（-DMYMUDUO_MIN_LOG_LEVEL=2 只保留ERROR/FATAL）
+ * 运行期：Logger::setLogLevel 设置的阈值，被过滤的日志只有一次原子读和一个分支，不会格式化
+ * 分支预测为被过滤：热路径上每个事件一条的DEBUG/INFO日志通常是关着的
+ */
+#ifndef MYMUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MYMUDUO_MIN_LOG_LEVEL 0 // DEBUG
+#else
+#define MYMUDUO_MIN_LOG_LEVEL 1 // INFO
+#endif
+#endif
+
+#define LOG_ENABLED(level) \
+    ((level) >= MYMUDUO_MIN_LOG_LEVEL && __builtin_expect((level) >= Logger::logLevel(), 0))
+
 // 使用方式：LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(LogmsgFormat, ...)                       \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_INFO(LogmsgFormat, ...)                                   \
+    do                                                                \
+    {                                                                 \
+        if (LOG_ENABLED(INFO))                                        \
+        {                                                             \
+            Logger::instance().log(INFO, LogmsgFormat, ##__VA_ARGS__); \
+        }                                                             \
     } while (0)
 
-#define LOG_ERROR(LogmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_ERROR(LogmsgFormat, ...)                                   \
+    do                                                                 \
+    {                                                                  \
+        if (LOG_ENABLED(ERROR))                                        \
+        {                                                              \
+            Logger::instance().log(ERROR, LogmsgFormat, ##__VA_ARGS__); \
+        }                                                              \
     } while (0)
 
-#define LOG_FATAL(LogmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+// FATAL不受级别过滤的影响
+#define LOG_FATAL(LogmsgFormat, ...)                               \
+    do                                                             \
+    {                                                              \
+        Logger::instance().log(FATAL, LogmsgFormat, ##__VA_ARGS__); \
+        exit(-1);                                                  \
     } while (0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(LogmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_DEBUG(LogmsgFormat, ...)                                   \
+    do                                                                 \
+    {                                                                  \
+        if (LOG_ENABLED(DEBUG))                                        \
+        {                                                              \
+            Logger::instance().log(DEBUG, LogmsgFormat, ##__VA_ARGS__); \
+        }                                                              \
     } while (0)
-#else
-#define LOG_DEBUG(LogmsgFormat, ...)
-#endif
 
-// 定义日志的级别 INFO，ERROR，FATAL，DEBUG
+// 定义日志的级别 DEBUG，INFO，ERROR，FATAL，按严重程度递增
 enum LogLevel
 {
+    DEBUG, ///< 调试信息
     INFO,  ///< 普通信息
     ERROR, ///< 错误信息
-    FATAL, ///< core信息
-    DEBUG  ///< 调试信息
+    FATAL  ///< core信息
 };
 
 // 输出一个日志类(单例模式)
@@ -65,12 +74,24 @@ class Logger : noncopyable
 public:
     // 获取日志唯一的实例对象
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行期的日志级别阈值，所有线程共享，线程安全
+    static int logLevel() { return logLevel_.load(std::memory_order_relaxed); }
+    static void setLogLevel(int level) { logLevel_.store(level, std::memory_order_relaxed); }
+
+    // 写日志，级别由调用方传入，格式化只在这里做一次
+    void log(int level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+    // 日志的输出目的地，默认是stdout，可以换成AsyncLogging等后端
+    using OutputFunc = void (*)(const char *msg, int len);
+    using FlushFunc = void (*)();
+    void setOutput(OutputFunc out) { output_ = out; }
+    void setFlush(FlushFunc flush) { flush_ = flush; }
 
 private:
-    int logLevel_;
-    Logger() {}
-};
\ No newline at end of file
+    static std::atomic_int logLevel_;
+
+    OutputFunc output_;
+    FlushFunc flush_;
+    Logger();
+};
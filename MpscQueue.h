@@ -0,0 +1,137 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <utility>
+
+// 测试用：pop把stub放回队尾之前调用，可以在这个位置插入其他生产者的push，见example/queuetest.cc
+#ifndef MPSCQUEUE_BEFORE_STUB_PUSH
+#define MPSCQUEUE_BEFORE_STUB_PUSH(queue)
+#endif
+
+/**
+ * 无锁的多生产者单消费者队列（Dmitry Vyukov的侵入式MPSC队列）
+ * push：任意线程，一次原子exchange + 一次store，没有锁也没有CAS重试
+ * pop：只能在消费者线程（EventLoop所在线程）调用
+ * 每个元素一个链表节点，出队后由消费者释放
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    struct Node
+    {
+        explicit Node(T &&v) : next(nullptr), value(std::move(v)) {}
+        Node() : next(nullptr), value() {}
+
+        std::atomic<Node *> next;
+        T value;
+    };
+
+    MpscQueue()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        while (Node *node = pop())
+        {
+            delete node;
+        }
+    }
+
+    // 生产者调用，线程安全
+    void push(T &&value)
+    {
+        pushNode(new Node(std::move(value)));
+    }
+
+    /**
+     * 消费者调用：依次对调用时已经入队的元素执行func并释放节点，执行过程中新入队的留到下一次，返回执行的个数
+     * 以调用时最后入队的节点为边界。这个节点可能是stub：pop把stub放回队尾之前有生产者插了进来，
+     * 队列变成 ... -> Y -> stub，Y也是这一次要执行的，所以执行到tail_回到stub为止
+     */
+    template <typename Func>
+    size_t consume(Func &&func)
+    {
+        Node *last = head_.load(std::memory_order_acquire);
+        const bool stubBound = (last == &stub_);
+        size_t count = 0;
+        while (!(stubBound && tail_ == &stub_))
+        {
+            Node *node = pop();
+            if (node == nullptr)
+            {
+                break;
+            }
+            bool isLast = (node == last);
+            func(node->value);
+            delete node;
+            ++count;
+            if (isLast)
+            {
+                break;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * 消费者调用，返回的节点由调用者delete
+     * 返回nullptr表示队列为空，或者某个生产者正在push的中间（已经exchange了head_但还没有链接next）
+     * 后一种情况下，该生产者push完成后会自己唤醒loop，不需要在这里自旋等待
+     */
+    Node *pop()
+    {
+        Node *tail = tail_;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        Node *head = head_.load(std::memory_order_acquire);
+        if (tail != head)
+        {
+            return nullptr;
+        }
+        // tail是最后一个节点，把stub放回队尾，tail才能出队
+        MPSCQUEUE_BEFORE_STUB_PUSH(this);
+        pushNode(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    void pushNode(Node *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 生产者和消费者访问的成员放在不同的cache line上，避免伪共享
+    std::atomic<Node *> head_; ///< 生产者：最后入队的节点
+    char pad_[64];
+    Node *tail_;               ///< 消费者：下一个出队的节点
+    Node stub_;
+};
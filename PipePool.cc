@@ -0,0 +1,62 @@
+#include "PipePool.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+void PipePool::closePipe(Pipe *pipe)
+{
+    if (pipe->valid())
+    {
+        ::close(pipe->readFd);
+        ::close(pipe->writeFd);
+    }
+    *pipe = invalidPipe();
+}
+
+PipePool::~PipePool()
+{
+    for (Pipe &pipe : idle_)
+    {
+        closePipe(&pipe);
+    }
+}
+
+PipePool::Pipe PipePool::acquire()
+{
+    if (!idle_.empty())
+    {
+        Pipe pipe = idle_.back();
+        idle_.pop_back();
+        return pipe;
+    }
+
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("PipePool::acquire pipe2 errno=%d \n", errno);
+        return invalidPipe();
+    }
+    // 调大管道减少splice的次数；超过pipe-max-size或者用户的管道总量限制时会失败，用默认大小
+    ::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(kPipeSize));
+    int capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+    return Pipe{fds[0], fds[1], static_cast<size_t>(capacity > 0 ? capacity : 4096), 0};
+}
+
+void PipePool::release(Pipe *pipe)
+{
+    if (!pipe->valid())
+    {
+        return;
+    }
+    if (pipe->bytes == 0 && idle_.size() < kMaxIdlePipes)
+    {
+        idle_.push_back(*pipe);
+        *pipe = invalidPipe();
+    }
+    else
+    {
+        closePipe(pipe);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * 每个EventLoop一个，给splice转发提供管道
+ * socket => pipe => socket，数据只在内核中移动
+ * 转发结束的空管道留着给下一次转发用，最多kMaxIdlePipes个；里面还有数据的管道直接关闭
+ * 只能在所属loop的线程中使用
+ */
+class PipePool : noncopyable
+{
+public:
+    static const size_t kPipeSize = 256 * 1024; ///< 期望的管道容量，超过系统限制时用默认大小
+    static const size_t kMaxIdlePipes = 64;
+
+    struct Pipe
+    {
+        int readFd;
+        int writeFd;
+        size_t capacity; ///< 管道实际容量
+        size_t bytes;    ///< 管道中还没有读出的字节数
+
+        bool valid() const { return readFd >= 0; }
+    };
+
+    static Pipe invalidPipe() { return Pipe{-1, -1, 0, 0}; }
+    // 关闭管道，*pipe变为无效
+    static void closePipe(Pipe *pipe);
+
+    PipePool() = default;
+    ~PipePool();
+
+    // 取一个空管道，fd用完时返回无效的管道
+    Pipe acquire();
+    // 还回管道，*pipe变为无效
+    void release(Pipe *pipe);
+
+    size_t numIdle() const { return idle_.size(); }
+
+private:
+    std::vector<Pipe> idle_;
+};
@@ -2,14 +2,49 @@
 #include "Channel.h"
 
 Poller::Poller(EventLoop* loop)
-    : ownerLoop_(loop)
+    : channels_(kInitChannelTableSize)
+    , ownerLoop_(loop)
+    , numChannels_(0)
 {
 }
 
 bool Poller::hasChannel(Channel* channel) const
 {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return findChannel(channel->fd()) == channel;
 }
 
-// 这里并没有实现newDefaultPoller这个方法（在外部公共地方实现），因为基类最好不要依赖于派生类
\ No newline at end of file
+Poller::ChannelEntry &Poller::entry(int fd)
+{
+    if (static_cast<size_t>(fd) >= channels_.size())
+    {
+        // 按倍数扩容，fd一般从小到大复用，扩容次数很少
+        size_t size = channels_.size() * 2;
+        while (size <= static_cast<size_t>(fd))
+        {
+            size *= 2;
+        }
+        channels_.resize(size);
+    }
+    return channels_[fd];
+}
+
+void Poller::addChannel(ChannelEntry &e, Channel *channel)
+{
+    if (e.channel == nullptr)
+    {
+        ++numChannels_;
+    }
+    e.channel = channel;
+}
+
+void Poller::eraseChannel(ChannelEntry &e)
+{
+    if (e.channel != nullptr)
+    {
+        --numChannels_;
+    }
+    e.channel = nullptr;
+    e.state = kNew;
+}
+
+// 这里并没有实现newDefaultPoller这个方法（在外部公共地方实现），因为基类最好不要依赖于派生类
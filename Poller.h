@@ -4,7 +4,7 @@
 #include "Timestamp.h"
 
 #include <vector>
-#include <unordered_map>
+#include <stddef.h>
 
 class Channel;
 class EventLoop;
@@ -30,10 +30,36 @@ public:
     static Poller* newDefaultPoller(EventLoop* loop);
 
 protected:
-    // map的key：sockfd， value：sockfd所属的Channel类型
-    using ChannelMap = std::unordered_map<int, Channel *>;
-    ChannelMap channels_;
+    // channel在poller中的注册状态
+    static const int kNew = -1;    ///< channel未添加到poller中
+    static const int kAdded = 1;   ///< channel已添加到poller中
+    static const int kDeleted = 2; ///< channel从poller中删除（没有关注的事件），但还在表里
+
+    // fd是小而稠密的整数，直接用fd做下标，Channel指针和注册状态放在一起，增删不需要哈希和分配节点
+    struct ChannelEntry
+    {
+        ChannelEntry() : channel(nullptr), state(kNew) {}
+
+        Channel *channel;
+        int state;
+    };
+
+    // fd超出当前表的大小时扩容
+    ChannelEntry &entry(int fd);
+    Channel *findChannel(int fd) const
+    {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd].channel : nullptr;
+    }
+    // 注册/删除channel，同时维护channel数量
+    void addChannel(ChannelEntry &e, Channel *channel);
+    void eraseChannel(ChannelEntry &e);
+    size_t numChannels() const { return numChannels_; }
+
+    std::vector<ChannelEntry> channels_; ///< 下标：sockfd
 
 private:
+    static const size_t kInitChannelTableSize = 64;
+
     EventLoop* ownerLoop_; ///< Poller所属的事件循环EventLoop
+    size_t numChannels_;
 };
\ No newline at end of file
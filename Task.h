@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 只能移动的 void() 可调用对象，用来代替EventLoop里的std::function
+ * std::function只有16字节的内部存储，std::bind(&TcpConnection::xxx, shared_ptr, ...)基本都会放到堆上，
+ * 而且拷贝一次就要再分配一次；Task有kInlineSize字节的内部存储，装得下的可调用对象不分配内存，
+ * 只能移动，不会被意外拷贝。装不下的才放到堆上
+ */
+class Task
+{
+public:
+    static const size_t kInlineSize = 64;
+
+    Task() noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+    {
+        using Fn = typename std::decay<F>::type;
+        init<Fn>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Fn>()>());
+    }
+
+    Task(Task &&other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(&storage_); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+private:
+    // 手写的虚函数表，每种可调用类型一份静态实例
+    struct Ops
+    {
+        void (*invoke)(void *storage);
+        void (*move)(void *dst, void *src); ///< 移动构造到dst，并析构src
+        void (*destroy)(void *storage);
+    };
+
+    using Storage = typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type;
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= kInlineSize
+            && alignof(Fn) <= alignof(Storage)
+            && std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    // 直接存放在storage_中
+    template <typename Fn>
+    struct InlineOps
+    {
+        static void invoke(void *storage) { (*static_cast<Fn *>(storage))(); }
+        static void move(void *dst, void *src)
+        {
+            ::new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        }
+        static void destroy(void *storage) { static_cast<Fn *>(storage)->~Fn(); }
+        static const Ops ops;
+    };
+
+    // storage_中只存一个指针
+    template <typename Fn>
+    struct HeapOps
+    {
+        static Fn *&ptr(void *storage) { return *static_cast<Fn **>(storage); }
+        static void invoke(void *storage) { (*ptr(storage))(); }
+        static void move(void *dst, void *src) { ::new (dst) Fn *(ptr(src)); }
+        static void destroy(void *storage) { delete ptr(storage); }
+        static const Ops ops;
+    };
+
+    template <typename Fn, typename F>
+    void init(F &&f, std::true_type)
+    {
+        ::new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    }
+
+    template <typename Fn, typename F>
+    void init(F &&f, std::false_type)
+    {
+        ::new (&storage_) Fn *(new Fn(std::forward<F>(f)));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+
+    void reset()
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
+
+template <typename Fn>
+const Task::Ops Task::InlineOps<Fn>::ops = {&InlineOps<Fn>::invoke, &InlineOps<Fn>::move, &InlineOps<Fn>::destroy};
+
+template <typename Fn>
+const Task::Ops Task::HeapOps<Fn>::ops = {&HeapOps<Fn>::invoke, &HeapOps<Fn>::move, &HeapOps<Fn>::destroy};
@@ -5,14 +5,24 @@
 #include "EventLoop.h"
 
 #include <functional>
+#include <algorithm>
 #include <errno.h>
+#include <limits.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
 #include <strings.h>
 #include <string>
 #include <unistd.h>
 
+// 连接销毁后收取零拷贝完成通知的间隔，从kZeroCopyReapMinSeconds开始加倍
+static const double kZeroCopyReapMinSeconds = 0.001;
+static const double kZeroCopyReapMaxSeconds = 1.0;
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
     if (loop == nullptr)
@@ -23,36 +33,74 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
 }
 
 TcpConnection::TcpConnection(EventLoop *loop,
-                  const std::string nameArg,
+                  uint64_t id,
+                  const std::shared_ptr<const std::string> &namePrefix,
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr)
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , id_(id)
+    , namePrefix_(namePrefix)
+    , name_(nullptr)
     , state_(kConnecting)
     , reading_(true)
-    , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
+    , socket_(sockfd)
+    , channel_(loop, sockfd)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024)  // 64M
+    , bufferShrinkThreshold_(kDefaultBufferShrinkThreshold)
+    , accountedInputBytes_(0)
+    , outputBuffer_(loop->chunkPool())
+    , zeroCopyThreshold_(0)
+    , zeroCopyNextId_(0)
+    , corked_(false)
+    , flushQueued_(false)
+    , forwarding_(false)
+    , forwardPipe_(PipePool::invalidPipe())
 {
+    idleEntry_.conn = this;
+    bufferEntry_.conn = this;
+
     // 给Channel设置相应的回调，poller通知感兴趣的事件发生，Channel会执行相应的回调
-    channel_->setReadCallback(
-        std::bind(&TcpConnection::handleRead, this, std::placeholders::_1)
-    );
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    // 只捕获this的lambda放得下std::function的内部存储，不用像std::bind那样分配内存
+    channel_.setReadCallback([this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_.setWriteCallback([this]() { handleWrite(); });
+    channel_.setCloseCallback([this]() { handleClose(); });
+    channel_.setErrorCallback([this]() { handleError(); });
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d \n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    // 建立和销毁连接的日志只打印id和对端地址，不为了日志拼出名字
+    LOG_INFO("TcpConnection::ctor[#%llu %s] at fd=%d \n",
+        (unsigned long long)id_, peerAddr_.toIpPort().c_str(), sockfd);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n",
-        name_.c_str(), channel_->fd(), (int)state_);
+    LOG_INFO("TcpConnection::dtor[#%llu %s] at fd=%d state=%d \n",
+        (unsigned long long)id_, peerAddr_.toIpPort().c_str(), channel_.fd(), (int)state_);
+    // 正常情况下已经在connectDestroyed中还给了管道池
+    PipePool::closePipe(&forwardPipe_);
+    delete name_.load(std::memory_order_acquire);
+}
+
+const std::string &TcpConnection::getName() const
+{
+    const std::string *name = name_.load(std::memory_order_acquire);
+    if (name == nullptr)
+    {
+        // 多个线程同时拼出来时只有一个能装进去，其余的丢掉
+        std::string *built = new std::string(*namePrefix_ + std::to_string(id_));
+        if (name_.compare_exchange_strong(name, built, std::memory_order_acq_rel))
+        {
+            name = built;
+        }
+        else
+        {
+            delete built;
+        }
+    }
+    return *name;
 }
 
 void TcpConnection::send(const std::string &buf)
@@ -61,23 +109,271 @@ void TcpConnection::send(const std::string &buf)
     {
         if (loop_->isInLoopThread())
         {
-            sendInLoop(buf.c_str(), buf.size());
+            sendInLoop(buf.data(), buf.size());
+        }
+        else
+        {
+            // 调用者的buf在返回后可能就被修改或者释放了，只能拷贝一份
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), buf)
+            );
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(buf);
+        }
+        else
+        {
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(buf))
+            );
+        }
+    }
+}
+
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(),
+                          std::string(static_cast<const char *>(data), len))
+            );
+        }
+    }
+}
+
+struct TcpConnection::SendBufferTask
+{
+    SendBufferTask(TcpConnectionPtr c, Buffer &&b)
+        : conn(std::move(c))
+        , buf(std::move(b))
+    {
+    }
+
+    void operator()()
+    {
+        conn->sendInLoop(buf.peek(), buf.readableBytes());
+    }
+
+    TcpConnectionPtr conn;
+    Buffer buf;
+};
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            // 交换内存，调用者的buf变为空，数据不拷贝
+            Buffer data;
+            data.swap(*buf);
+            loop_->queueInLoop(
+                SendBufferTask(shared_from_this(), std::move(data))
+            );
+        }
+    }
+}
+
+void TcpConnection::sendv(const struct iovec *slices, int count)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(slices, count);
+        }
+        else
+        {
+            // 分片指向调用者的内存，只能拼成一份拷贝投递过去
+            std::string data;
+            for (int i = 0; i < count; ++i)
+            {
+                data.append(static_cast<const char *>(slices[i].iov_base), slices[i].iov_len);
+            }
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(data))
+            );
         }
     }
+}
+
+// buf是投递的任务持有的数据，可以直接移走
+void TcpConnection::sendStringInLoop(std::string &buf)
+{
+    if (buf.size() >= ChunkPool::kChunkDataSize)
+    {
+        // 大数据转成共享的payload，一次写不完的部分不用再拷贝进outputBuffer_
+        sendSharedInLoop(std::make_shared<const std::string>(std::move(buf)));
+    }
     else
+    {
+        sendInLoop(buf.data(), buf.size());
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
     {
         loop_->runInLoop(
-            std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size())
+            std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, length)
         );
     }
 }
 
+void TcpConnection::send(const std::shared_ptr<const std::string> &payload)
+{
+    if (state_ == kConnected)
+    {
+        loop_->runInLoop(
+            std::bind(&TcpConnection::sendSharedInLoop, shared_from_this(), payload)
+        );
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    if (state_ == kDisConnected)
+    {
+        LOG_ERROR("disconnected, give up sending file! \n");
+        return;
+    }
+    queueSegment(PendingSegment{nullptr, false, fd, offset, length, 0});
+}
+
+void TcpConnection::sendSharedInLoop(const std::shared_ptr<const std::string> &payload)
+{
+    const bool zeroCopy = zeroCopyThreshold_ > 0 && payload->size() >= zeroCopyThreshold_;
+    if (!zeroCopy && payload->size() < ChunkPool::kChunkDataSize)
+    {
+        // 小数据拷贝进outputBuffer_比单独排队更省
+        sendInLoop(payload->data(), payload->size());
+        return;
+    }
+    if (state_ == kDisConnected)
+    {
+        LOG_ERROR("disconnected, give up writing! \n");
+        return;
+    }
+    queueSegment(PendingSegment{payload, zeroCopy, -1, 0, payload->size(), 0});
+}
+
+// 排在已经缓冲的数据后面；之后send的数据追加到outputBuffer_，由bufferedBefore保证排在这一段后面
+void TcpConnection::queueSegment(const PendingSegment &segment)
+{
+    size_t bufferedBefore = outputBuffer_.readableBytes();
+    for (const PendingSegment &pending : pendingSegments_)
+    {
+        bufferedBefore -= pending.bufferedBefore;
+    }
+    pendingSegments_.push_back(segment);
+    pendingSegments_.back().bufferedBefore = bufferedBefore;
+
+    if (!channel_.isWriting() && corked_)
+    {
+        queueFlush();
+    }
+    else if (!channel_.isWriting())
+    {
+        // 之前没有待发送的数据，先直接发，发不完再注册epollout事件
+        int saveErrno = 0;
+        if (flushOutput(&saveErrno))
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+        }
+        else if (saveErrno == 0 || saveErrno == EAGAIN || saveErrno == EWOULDBLOCK)
+        {
+            channel_.enableWriting();
+        }
+    }
+}
+
+void TcpConnection::queueFlush()
+{
+    if (!flushQueued_)
+    {
+        flushQueued_ = true;
+        loop_->queueFlush(std::bind(&TcpConnection::flushCorked, shared_from_this()));
+    }
+}
+
+// 攒包模式下由loop在处理完活跃Channel之后调用，把这一轮send的数据一次发出去
+void TcpConnection::flushCorked()
+{
+    flushQueued_ = false;
+    if (state_ == kDisConnected || channel_.isWriting())
+    {
+        return;     // 已经断开，或者已经在等epollout，由handleWrite接着发
+    }
+    int saveErrno = 0;
+    if (flushOutput(&saveErrno))
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
+        }
+        if (state_ == kDisConnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+    else if (saveErrno == 0 || saveErrno == EAGAIN || saveErrno == EWOULDBLOCK)
+    {
+        channel_.enableWriting();
+    }
+    else
+    {
+        LOG_ERROR("TcpConnection::flushCorked \n");
+    }
+}
+
 // 发送数据，应用写的快，内核发送数据慢，需要把发送数据写入缓冲区，而且设置了高水位回调
 void TcpConnection::sendInLoop(const void *data, size_t len)
 {
+    struct iovec slice;
+    slice.iov_base = const_cast<void *>(data);
+    slice.iov_len = len;
+    sendvInLoop(&slice, 1);
+}
+
+void TcpConnection::sendvInLoop(const struct iovec *slices, int count)
+{
+    size_t len = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        len += slices[i].iov_len;
+    }
     ssize_t rwrote = 0;
     size_t remaining = len;
     bool faultError = false;
+    bool socketFull = true; // 直接发送的时候是否把socket写满了，没有写满说明只是受IOV_MAX的限制
 
     // 之前已经调用过该connection的shutdown，不能再发送了
     if (state_ == kDisConnected)
@@ -85,13 +381,25 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         LOG_ERROR("disconnected, give up writing! \n");
         return;
     }
-    // channel第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // channel第一次开始写数据，而且缓冲区没有待发送数据；攒包模式下留到本轮结束再发
+    if (!corked_ && !channel_.isWriting() && outputBuffer_.readableBytes() == 0 && pendingSegments_.empty())
     {
-        rwrote = ::write(channel_->fd(), data, len);
+        // 多个分片一次writev发出去，超过IOV_MAX的分片留给缓冲区
+        const int batch = std::min(count, IOV_MAX);
+        rwrote = count == 1 ? ::write(channel_.fd(), slices[0].iov_base, len)
+                            : ::writev(channel_.fd(), slices, batch);
         if (rwrote >= 0)
         {
             remaining = len - rwrote;
+            if (batch < count)
+            {
+                size_t batchLen = 0;
+                for (int i = 0; i < batch; ++i)
+                {
+                    batchLen += slices[i].iov_len;
+                }
+                socketFull = static_cast<size_t>(rwrote) < batchLen;
+            }
             if (remaining == 0 && writeCompleteCallback_)
             {
                 // 既然在这里直接一次性发送完了，就不需要再给channel设置epollout事件了
@@ -129,10 +437,46 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
                 std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining)
             );
         }
-        outputBuffer_.append((char*)data + rwrote, remaining);
-        if (!channel_->isWriting())
+        // 跳过已经发送的部分，只把剩下的数据追加到缓冲区
+        size_t skip = rwrote;
+        for (int i = 0; i < count; ++i)
         {
-            channel_->enableWriting();  // 注册channel的写事件  
+            if (skip >= slices[i].iov_len)
+            {
+                skip -= slices[i].iov_len;
+                continue;
+            }
+            outputBuffer_.append(static_cast<const char *>(slices[i].iov_base) + skip, slices[i].iov_len - skip);
+            skip = 0;
+        }
+        if (!channel_.isWriting())
+        {
+            if (corked_)
+            {
+                queueFlush();
+            }
+            else if (!socketFull)
+            {
+                // socket还有空间，接着发；ET模式下EPOLLOUT一直注册着，enableWriting不会产生新的边沿
+                int saveErrno = 0;
+                if (flushOutput(&saveErrno))
+                {
+                    if (writeCompleteCallback_)
+                    {
+                        loop_->queueInLoop(
+                            std::bind(writeCompleteCallback_, shared_from_this())
+                        );
+                    }
+                }
+                else if (saveErrno == 0 || saveErrno == EAGAIN || saveErrno == EWOULDBLOCK)
+                {
+                    channel_.enableWriting();
+                }
+            }
+            else
+            {
+                channel_.enableWriting();  // 注册channel的写事件  
+            }
         }
     }   
 }
@@ -151,9 +495,10 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting())         // 说明outputBuffer中的数据已经全部发送完毕
+    // 说明outputBuffer中的数据已经全部发送完毕；攒下的数据由flushCorked发完之后再shutdown
+    if (!channel_.isWriting() && !flushQueued_)
     {
-        socket_->shutdownWrite();       // 关闭写端
+        socket_.shutdownWrite();       // 关闭写端
     }
 }
 
@@ -161,8 +506,12 @@ void TcpConnection::shutdownInLoop()
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading();      // 向poller注册channel的EPOLLIN事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading();      // 向poller注册channel的EPOLLIN事件
+    if (idleWheel_)
+    {
+        idleWheel_->add(&idleEntry_);
+    }
 
     // 新连接建立，执行回调
     connectionCallback_(shared_from_this());
@@ -174,22 +523,135 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisConnected);
-        channel_->disableAll();     // 把channel所有的感兴趣事件，从poller中del掉
+        channel_.disableAll();     // 把channel所有的感兴趣事件，从poller中del掉
         connectionCallback_(shared_from_this());
     }
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    if (bufferWheel_)
+    {
+        bufferWheel_->remove(&bufferEntry_);
+    }
+
+    channel_.remove();     // 把channel从poller中删掉
+    // 缓冲区在loop线程中释放并更新统计，TcpConnection本身可能在其他线程析构
+    outputBuffer_.retrieveAll();
+    pendingSegments_.clear();
+    // 半关闭、空闲踢除、正常关闭之后内核都还会继续发送零拷贝的数据，payload要留到内核通知完成
+    reapZeroCopyCompletions(kZeroCopyReapMinSeconds);
+    loop_->pipePool()->release(&forwardPipe_);
+    // 本连接是转发的目标：源连接如果不再发数据，就一直发现不了本连接已经断开，通知它关闭
+    TcpConnectionPtr source(forwardSource_.lock());
+    if (source)
+    {
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, source));
+    }
+    inputBuffer_.shrink(0);
+    updateInputBufferBytes();
+}
 
-    channel_->remove();     // 把channel从poller中删掉
+// 空闲超时：和handleClose一样通知用户，但不走closeCallback，从TcpServer中的删除由时间轮的回调批量完成
+void TcpConnection::closeIdleInLoop()
+{
+    LOG_INFO("TcpConnection::closeIdleInLoop [#%llu %s] idle timeout \n",
+        (unsigned long long)id_, peerAddr_.toIpPort().c_str());
+    if (state_ == kConnected || state_ == kDisConnecting)
+    {
+        setState(kDisConnected);
+        channel_.disableAll();
+        connectionCallback_(shared_from_this());
+    }
 }
 
 
+void TcpConnection::shrinkBuffersInLoop()
+{
+    inputBuffer_.shrink(0);
+    updateInputBufferBytes();
+}
+
+// 读事件处理完之后：读完了而且超过阈值的inputBuffer马上释放，其余的交给时间轮，空闲一段时间后再释放
+void TcpConnection::reclaimInputBuffer()
+{
+    if (inputBuffer_.readableBytes() == 0 && inputBuffer_.internalCapacity() > bufferShrinkThreshold_)
+    {
+        inputBuffer_.shrink(0);
+    }
+    else if (bufferWheel_)
+    {
+        if (bufferEntry_.linked())
+        {
+            bufferWheel_->touch(&bufferEntry_);
+        }
+        else
+        {
+            bufferWheel_->add(&bufferEntry_);
+        }
+    }
+    updateInputBufferBytes();
+}
+
+void TcpConnection::updateInputBufferBytes()
+{
+    size_t capacity = inputBuffer_.internalCapacity();
+    if (capacity != accountedInputBytes_)
+    {
+        loop_->addInputBufferBytes(static_cast<int64_t>(capacity) - static_cast<int64_t>(accountedInputBytes_));
+        accountedInputBytes_ = capacity;
+    }
+}
+
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    channel_.setEdgeTriggered(on);
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_.setTcpNoDelay(on);
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+    if (threshold > 0 && zeroCopyThreshold_ == 0)
+    {
+        int on = 1;
+        if (::setsockopt(channel_.fd(), SOL_SOCKET, SO_ZEROCOPY, &on, sizeof on) < 0)
+        {
+            LOG_ERROR("TcpConnection::setZeroCopyThreshold [%s] SO_ZEROCOPY errno=%d \n", getName().c_str(), errno);
+            return;
+        }
+    }
+    zeroCopyThreshold_ = threshold;
+}
+
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (forwarding_)
+    {
+        handleForwardRead();
+        return;
+    }
+    if (channel_.isEdgeTriggered())
+    {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &saveErrno,
+                                    loop_->recvArena(), EventLoop::kRecvArenaSize, &recvSize_);
     if (n > 0)
     {
+        if (idleWheel_)
+        {
+            idleWheel_->touch(&idleEntry_);
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        reclaimInputBuffer();
     }
     else if (n == 0)
     {
@@ -203,48 +665,416 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
-void TcpConnection::handleWrite()
+// ET模式下必须把数据读完，否则不会再收到EPOLLIN
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
 {
-    if (channel_->isWriting())
+    int saveErrno = 0;
+    bool peerClosed = false;
+    ssize_t n = inputBuffer_.readFdUntilAgain(channel_.fd(), &saveErrno, &peerClosed,
+                                              loop_->recvArena(), EventLoop::kRecvArenaSize, &recvSize_);
+    if (n > 0)
     {
-        int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        if (idleWheel_)
+        {
+            idleWheel_->touch(&idleEntry_);
+        }
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        reclaimInputBuffer();
+    }
+
+    if (peerClosed)
+    {
+        handleClose();
+    }
+    else if (saveErrno != 0)
+    {
+        errno = saveErrno;
+        LOG_ERROR("TcpConnection::handleRead \n");
+        handleError();
+    }
+}
+
+void TcpConnection::forwardTo(const TcpConnectionPtr &dest)
+{
+    loop_->runInLoop(
+        std::bind(&TcpConnection::forwardToInLoop, shared_from_this(), dest)
+    );
+}
+
+void TcpConnection::forwardToInLoop(const TcpConnectionPtr &dest)
+{
+    if (dest->getLoop() != loop_)
+    {
+        LOG_ERROR("TcpConnection::forwardTo [%s] => [%s] not in the same loop \n",
+            getName().c_str(), dest->getName().c_str());
+        return;
+    }
+    forwardDest_ = dest;
+    dest->forwardSource_ = shared_from_this();
+    if (!dest->forwardPipe_.valid())
+    {
+        dest->forwardPipe_ = loop_->pipePool()->acquire();
+    }
+
+    if (dest->forwardPipe_.valid())
+    {
+        forwarding_ = true;
+    }
+    else
+    {
+        // 没有管道可用（fd用完），退回到经过inputBuffer_拷贝转发
+        std::weak_ptr<TcpConnection> weakDest(dest);
+        messageCallback_ = [weakDest](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+            TcpConnectionPtr d(weakDest.lock());
+            if (d)
+            {
+                d->sendInLoop(buf->peek(), buf->readableBytes());
+            }
+            buf->retrieveAll();
+        };
+    }
+    // 开始转发之前已经读到的数据
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        dest->sendInLoop(inputBuffer_.peek(), inputBuffer_.readableBytes());
+        inputBuffer_.retrieveAll();
+    }
+}
+
+// socket => dest的管道 => dest的socket；ET模式下一直读到EAGAIN
+void TcpConnection::handleForwardRead()
+{
+    TcpConnectionPtr dest(forwardDest_.lock());
+    if (!dest || dest->disconnected())
+    {
+        // 转发的目标已经断开，本连接也没有存在的必要了
+        handleClose();
+        return;
+    }
+
+    PipePool::Pipe &pipe = dest->forwardPipe_;
+    while (pipe.bytes < pipe.capacity)
+    {
+        ssize_t n = ::splice(channel_.fd(), nullptr, pipe.writeFd, nullptr,
+                             pipe.capacity - pipe.bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
         if (n > 0)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            pipe.bytes += n;
+            if (idleWheel_)
+            {
+                idleWheel_->touch(&idleEntry_);
+            }
+            if (!dest->drainForwardPipe())
+            {
+                break;
+            }
+            if (!channel_.isEdgeTriggered())
+            {
+                return;
+            }
+        }
+        else if (n == 0)
+        {
+            handleClose();
+            return;
+        }
+        else
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
             {
-                channel_->disableWriting();
-                if (writeCompleteCallback_)
+                LOG_ERROR("TcpConnection::handleForwardRead \n");
+                handleError();
+            }
+            return;
+        }
+    }
+    // dest发不动了，停止读，等dest把管道排空后再恢复（背压）
+    channel_.disableReading();
+}
+
+// 把forwardPipe_中的数据发出去，全部发完返回true；发不完就注册epollout，由handleWrite接着发
+// outputBuffer_中已经有数据时先等它发完
+bool TcpConnection::drainForwardPipe()
+{
+    if (forwardPipe_.bytes == 0)
+    {
+        return true;
+    }
+    if (outputBuffer_.readableBytes() == 0 && pendingSegments_.empty())
+    {
+        while (forwardPipe_.bytes > 0)
+        {
+            ssize_t n = ::splice(forwardPipe_.readFd, nullptr, channel_.fd(), nullptr,
+                                 forwardPipe_.bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n <= 0)
+            {
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
                 {
-                    // 下面这样写也行，loop_肯定就是subloop
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this())
-                    );
+                    LOG_ERROR("TcpConnection::drainForwardPipe [%s] errno=%d \n", getName().c_str(), errno);
                 }
-                if (state_ == kDisConnecting)
+                break;
+            }
+            forwardPipe_.bytes -= n;
+        }
+        if (forwardPipe_.bytes == 0)
+        {
+            return true;
+        }
+    }
+    if (!channel_.isWriting())
+    {
+        channel_.enableWriting();
+    }
+    return false;
+}
+
+// 转发的目标已经销毁，在loop中执行，源连接和目标连接属于同一个loop
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisConnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::resumeForwardRead()
+{
+    if (forwarding_ && (state_ == kConnected || state_ == kDisConnecting) && !channel_.isReading())
+    {
+        channel_.enableReading();
+    }
+}
+
+// 按顺序发送outputBuffer_中的数据和待发送的文件，全部发完返回true
+// ET模式下一直写到EAGAIN；LT模式下一次系统调用没有写完当前这一段就停下，等下一次epollout
+bool TcpConnection::flushOutput(int *savedErrno)
+{
+    const int sockfd = channel_.fd();
+    while (true)
+    {
+        ssize_t n = 0;
+        bool segmentDone = false;
+        if (!pendingSegments_.empty() && pendingSegments_.front().bufferedBefore == 0)
+        {
+            PendingSegment &segment = pendingSegments_.front();
+            if (segment.payload)
+            {
+                n = sendPayload(segment);
+                if (n > 0)
+                {
+                    segment.offset += n;
+                }
+            }
+            else
+            {
+                n = ::sendfile(sockfd, segment.fd, &segment.offset, segment.remaining);
+                if (n == 0)
+                {
+                    // 文件比length短，剩下的部分没法再发
+                    LOG_ERROR("TcpConnection::flushOutput [%s] file fd=%d ended early, %zu bytes not sent \n",
+                        getName().c_str(), segment.fd, segment.remaining);
+                    segmentDone = true;
+                }
+                else if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    // 文件fd无效、已经关闭或者不是普通文件：留在队列里每次EPOLLOUT都会再失败一次，
+                    // 后面的数据也没法按顺序发了，丢掉这一段并关闭连接
+                    int err = errno;
+                    LOG_ERROR("TcpConnection::flushOutput [%s] sendfile fd=%d errno=%d, closing \n",
+                        getName().c_str(), segment.fd, err);
+                    pendingSegments_.pop_front();
+                    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+                    errno = err;
+                }
+            }
+            if (n > 0)
+            {
+                segment.remaining -= n;
+                segmentDone = (segment.remaining == 0);
+            }
+            if (segmentDone)
+            {
+                pendingSegments_.pop_front();
+            }
+        }
+        else if (outputBuffer_.readableBytes() > 0)
+        {
+            size_t len = pendingSegments_.empty() ? outputBuffer_.readableBytes() : pendingSegments_.front().bufferedBefore;
+            n = outputBuffer_.writeFd(sockfd, savedErrno, len);
+            if (n > 0)
+            {
+                outputBuffer_.retrieve(n);
+                if (!pendingSegments_.empty())
                 {
-                    shutdownInLoop();
+                    pendingSegments_.front().bufferedBefore -= n;
                 }
+                segmentDone = (static_cast<size_t>(n) == len);
             }
         }
         else
+        {
+            return true;
+        }
+
+        if (n < 0)
+        {
+            if (savedErrno != nullptr && *savedErrno == 0)
+            {
+                *savedErrno = errno;
+            }
+            return false;
+        }
+        if (!segmentDone && !channel_.isEdgeTriggered())
+        {
+            return false;
+        }
+    }
+}
+
+ssize_t TcpConnection::sendPayload(const PendingSegment &segment)
+{
+    const char *data = segment.payload->data() + segment.offset;
+    const size_t len = segment.remaining;
+    if (!segment.zeroCopy || zeroCopyThreshold_ == 0)
+    {
+        // 不需要零拷贝，或者排队之后零拷贝被关闭了
+        return ::send(channel_.fd(), data, len, 0);
+    }
+    ssize_t n = ::send(channel_.fd(), data, len, MSG_ZEROCOPY);
+    if (n > 0)
+    {
+        zeroCopyInFlight_.push_back(ZeroCopyRef{zeroCopyNextId_++, segment.payload});
+    }
+    else if (n < 0 && errno == ENOBUFS)
+    {
+        // 完成通知占用的内存超过了optmem_max，这一次退回到拷贝
+        n = ::send(channel_.fd(), data, len, 0);
+    }
+    return n;
+}
+
+// 读出错误队列中的零拷贝完成通知，释放对应的payload
+void TcpConnection::handleZeroCopyCompletions()
+{
+    while (true)
+    {
+        char control[128];
+        struct msghdr msg;
+        ::bzero(&msg, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(channel_.fd(), &msg, MSG_ERRQUEUE) < 0)
+        {
+            break;   // EAGAIN：错误队列已经读空
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+            const struct sock_extended_err *err = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            // [ee_info, ee_data]区间内的发送已经完成
+            while (!zeroCopyInFlight_.empty()
+                   && static_cast<int32_t>(zeroCopyInFlight_.front().id - err->ee_data) <= 0)
+            {
+                zeroCopyInFlight_.pop_front();
+            }
+            if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && zeroCopyThreshold_ > 0)
+            {
+                LOG_INFO("TcpConnection [%s] kernel copied zero-copy sends, zero-copy disabled \n", getName().c_str());
+                zeroCopyThreshold_ = 0;
+            }
+        }
+    }
+}
+
+// 连接已经销毁，但还有零拷贝发送没完成：连接对象（连同fd）由定时器持有，间隔加倍地收取完成通知
+// fd不关闭，内核照常发送和重传，对端确认之后（或者TCP自己超时放弃之后）就会通知完成
+void TcpConnection::reapZeroCopyCompletions(double delay)
+{
+    handleZeroCopyCompletions();
+    if (!zeroCopyInFlight_.empty())
+    {
+        TcpConnectionPtr self(shared_from_this());
+        double next = std::min(delay * 2, kZeroCopyReapMaxSeconds);
+        loop_->runAfter(delay, [self, next]() { self->reapZeroCopyCompletions(next); });
+    }
+}
+
+void TcpConnection::handleWrite()
+{
+    if (channel_.isWriting())
+    {
+        int saveErrno = 0;
+        if (flushOutput(&saveErrno) && drainForwardPipe())
+        {
+            channel_.disableWriting();
+            if (forwardPipe_.valid())
+            {
+                TcpConnectionPtr source(forwardSource_.lock());
+                if (source)
+                {
+                    source->resumeForwardRead();
+                }
+            }
+            if (writeCompleteCallback_)
+            {
+                // 下面这样写也行，loop_肯定就是subloop
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+            if (state_ == kDisConnecting)
+            {
+                shutdownInLoop();
+            }
+        }
+        else if (saveErrno != 0 && saveErrno != EAGAIN && saveErrno != EWOULDBLOCK)
         {
             LOG_ERROR("TcpConnection::handleWrite \n");
         }
     }
     else
     {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_->fd());
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_.fd());
     }
 }
 
 // poller => channel::closeCallback => TcpConnection::handleClose
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_.fd(), (int)state_);
     setState(kDisConnected);
-    channel_->disableAll();
+    channel_.disableAll();
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    if (bufferWheel_)
+    {
+        bufferWheel_->remove(&bufferEntry_);
+    }
+    // 转发的目标发完管道中的数据后shutdown；源连接可能因为背压停止了读，恢复之后它会发现本连接已经断开
+    TcpConnectionPtr dest(forwardDest_.lock());
+    if (dest)
+    {
+        dest->shutdown();
+    }
+    TcpConnectionPtr source(forwardSource_.lock());
+    if (source)
+    {
+        source->resumeForwardRead();
+    }
  
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr);   // 执行连接关闭的回调
@@ -253,10 +1083,17 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+    // 零拷贝的完成通知也通过EPOLLERR上报，这时SO_ERROR为0
+    const bool zeroCopyPending = !zeroCopyInFlight_.empty();
+    if (zeroCopyPending)
+    {
+        handleZeroCopyCompletions();
+    }
+
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -264,5 +1101,9 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
+    if (err != 0 || !zeroCopyPending)
+    {
+        LOG_ERROR("TcpConnection::handleError [#%llu %s] - SO_ERROR:%d \n",
+            (unsigned long long)id_, peerAddr_.toIpPort().c_str(), err);
+    }
 }
\ No newline at end of file
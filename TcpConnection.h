@@ -4,15 +4,22 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
+#include "AdaptiveRecvSize.h"
+#include "PipePool.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
+#include "Channel.h"
+#include "Socket.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <list>
+#include <sys/types.h>
+#include <sys/uio.h>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept得到connfd
@@ -21,36 +28,93 @@ class Socket;
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
 public:
+    // 名字为 namePrefix + id，第一次调用getName时才拼出来
     TcpConnection(EventLoop *loop,
-                  const std::string nameArg,
+                  uint64_t id,
+                  const std::shared_ptr<const std::string> &namePrefix,
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
-    const std::string &getName() const { return name_; }
+    uint64_t id() const { return id_; }
+    const std::string &getName() const;
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
     bool disconnected() const { return state_ == kDisConnected; }
 
-    // 发送数据
+    // 发送数据，线程安全；在其他线程调用时数据随投递到loop的任务一起移动，只在需要时拷贝一次：
+    // const std::string& 和 (data, len) 拷贝一次；std::string&& 直接移动；Buffer* 交换内存，调用后buf为空
+    // 连接已经不是kConnected状态时丢弃数据
     void send(const std::string &buf);
+    void send(std::string &&buf);
+    void send(const void *data, size_t len);
+    void send(Buffer *buf);
+    // 分散的多段数据（比如头部 + 正文 + 尾部）按顺序发送，不用先拼接：
+    // 在loop线程中没有待发送数据时一次writev发出去，只把没发完的部分追加到outputBuffer_
+    void sendv(const struct iovec *slices, int count);
+    // 用sendfile发送文件fd中[offset, offset + length)的内容，数据不经过用户态
+    // 和send的数据按调用顺序发送；全部发送完后调用writeCompleteCallback
+    // fd由调用者持有，必须保持打开直到writeCompleteCallback或者连接关闭
+    void sendFile(int fd, off_t offset, size_t length);
+    // 发送共享的数据，一个块以上的直接从payload发送，不拷贝进outputBuffer_；
+    // 不小于零拷贝阈值时用MSG_ZEROCOPY发送，一直持有payload直到内核在错误队列中通知发送完成，writeCompleteCallback不等这个通知
+    void send(const std::shared_ptr<const std::string> &payload);
     // 关闭连接
     void shutdown();
 
+    // 把本连接收到的数据经过管道用splice直接转发给dest，之后不再调用messageCallback
+    // 两个连接必须属于同一个loop，双向转发对两个连接各调用一次
+    // dest发不动时停止读本连接（背压），dest把管道排空后恢复；本连接关闭后dest发完管道中的数据再shutdown
+    // dest销毁后本连接也随之关闭
+    // 转发的数据和直接send给dest的数据之间不保证顺序
+    void forwardTo(const TcpConnectionPtr &dest);
+
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb) { highWaterMarkCallback_ = cb; }
     void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+    // 边沿触发模式，必须在connectEstablished之前设置
+    void setEdgeTriggered(bool on);
+
+    // 零拷贝发送的阈值，0表示关闭；设置SO_ZEROCOPY失败（内核不支持）时保持关闭
+    // 内核报告退回了拷贝（比如loopback）时自动关闭；必须在connectEstablished之前设置
+    void setZeroCopyThreshold(size_t threshold);
+    size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+    // 关闭Nagle算法，小块数据立即发出
+    void setTcpNoDelay(bool on);
+
+    // 攒包模式：同一轮事件处理中的多次send只追加到outputBuffer_，处理完活跃Channel后由loop统一发送一次
+    // 适合一个onMessage里多次send的请求-应答协议；在loop线程中或者connectEstablished之前设置
+    void setCorked(bool on) { corked_ = on; }
+    bool corked() const { return corked_; }
+
+    // 空闲连接踢除用的时间轮，必须在connectEstablished之前设置
+    void setIdleWheel(const std::shared_ptr<TimingWheel> &wheel) { idleWheel_ = wheel; }
+
+    // inputBuffer读完之后，容量超过threshold的马上释放，其余的在wheel上空闲超时后释放（wheel可以为空）
+    // 必须在connectEstablished之前设置
+    static const size_t kDefaultBufferShrinkThreshold = 1024 * 1024;
+    void setBufferShrink(const std::shared_ptr<TimingWheel> &wheel, size_t threshold)
+    {
+        bufferWheel_ = wheel;
+        bufferShrinkThreshold_ = threshold;
+    }
+
     // 连接建立
     void connectEstablished();
     // 连接销毁
     void connectDestroyed();
+    // 空闲超时，由TimingWheel在subLoop中批量调用，之后由TcpServer批量销毁
+    void closeIdleInLoop();
+    // 缓冲区空闲超时，由TimingWheel在subLoop中批量调用，释放（或收缩到只放得下剩余数据）inputBuffer
+    void shrinkBuffersInLoop();
 
 private:
     enum StateE
@@ -64,24 +128,51 @@ private:
     void setState(StateE state) { state_ = state; };
 
     void handleRead(Timestamp receiveTime);
+    void handleReadEdgeTriggered(Timestamp receiveTime);
     void handleWrite();
     void handleError();
     void handleClose();
 
     void sendInLoop(const void *data, size_t len);
+    void sendvInLoop(const struct iovec *slices, int count);
+    void sendStringInLoop(std::string &buf);
+    struct SendBufferTask;  // 持有连接和交换过来的Buffer，比std::bind小，能放进Task的内部存储
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+    void sendSharedInLoop(const std::shared_ptr<const std::string> &payload);
+    bool flushOutput(int *savedErrno);
+    struct PendingSegment;
+    ssize_t sendPayload(const PendingSegment &segment);
+    void handleZeroCopyCompletions();
+    void reapZeroCopyCompletions(double delay);
+    void queueFlush();
+    void flushCorked();
+
+    void forwardToInLoop(const TcpConnectionPtr &dest);
+    void handleForwardRead();
+    bool drainForwardPipe();
+    void resumeForwardRead();
+
+    // 连接还没有关闭时关闭它：转发的目标已经销毁，或者发送出错没法再按顺序发下去
+    void forceCloseInLoop();
+
+    void reclaimInputBuffer();
+    void updateInputBufferBytes();
 
     // void shutdown();
     void shutdownInLoop();
 
     EventLoop *loop_; ///< 这里肯定不是mainLoop，因为TcpConnection都是在subLoop中管理的
-    const std::string name_;
+    const uint64_t id_;
+    std::shared_ptr<const std::string> namePrefix_;
+    mutable std::atomic<const std::string *> name_; ///< 第一次getName时拼出来，可能在多个线程中同时调用
     std::atomic_int state_;
     bool reading_;
 
     // 这里和Acceptor类似：
     //         acceptor是工作在mainloop中      TcpConnection工作在subloop中 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，建立连接时不用单独分配
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -94,6 +185,47 @@ private:
 
     size_t highWaterMark_;
 
-    Buffer inputBuffer_;    ///< 接受数据的缓冲区
-    Buffer outputBuffer_;   ///< 发送数据的缓冲区
+    std::shared_ptr<TimingWheel> idleWheel_; ///< 没有设置空闲超时则为空
+    TimingWheel::Entry idleEntry_;
+
+    Buffer inputBuffer_;    ///< 接受数据的缓冲区，第一次读时才分配内存
+    AdaptiveRecvSize recvSize_; ///< 按最近的读取量预测下一次读多少，读之前把inputBuffer_扩到这个大小
+    std::shared_ptr<TimingWheel> bufferWheel_; ///< 没有设置缓冲区空闲时间则为空
+    TimingWheel::Entry bufferEntry_;
+    size_t bufferShrinkThreshold_;
+    size_t accountedInputBytes_; ///< 已经计入loop统计的inputBuffer容量
+    ChainBuffer outputBuffer_; ///< 发送数据的缓冲区，分块存放，慢速的接收方不会导致整体扩容拷贝
+
+    // 不经过outputBuffer_发送的一段数据：sendfile的文件，或者零拷贝发送的payload
+    struct PendingSegment
+    {
+        std::shared_ptr<const std::string> payload; ///< 为空表示文件
+        bool zeroCopy;
+        int fd;
+        off_t offset; ///< 文件或者payload中下一个要发送的位置
+        size_t remaining;
+        size_t bufferedBefore; ///< outputBuffer_中排在这一段前面（上一段之后）还没发送的字节数
+    };
+    void queueSegment(const PendingSegment &segment);
+
+    // 和outputBuffer_一起构成发送队列；大多数连接用不到，用list是因为空的list不分配内存（deque的默认构造就要分配）
+    std::list<PendingSegment> pendingSegments_;
+
+    // 每次成功的MSG_ZEROCOPY发送占用一个序号，内核按序号区间通知完成
+    struct ZeroCopyRef
+    {
+        uint32_t id;
+        std::shared_ptr<const std::string> payload;
+    };
+    size_t zeroCopyThreshold_;
+    uint32_t zeroCopyNextId_;
+    std::list<ZeroCopyRef> zeroCopyInFlight_; ///< 内核还没有通知完成的发送，同样用list
+
+    bool corked_;
+    bool flushQueued_; ///< 已经加入loop的flush列表，本轮结束时发送
+
+    bool forwarding_; ///< 收到的数据用splice转发给forwardDest_
+    std::weak_ptr<TcpConnection> forwardDest_;
+    std::weak_ptr<TcpConnection> forwardSource_; ///< 把数据转发给本连接的连接，管道排空后恢复它的读
+    PipePool::Pipe forwardPipe_; ///< 转发给本连接、还没发出去的数据，放在目标连接上，源连接关闭后也不会丢
 };
\ No newline at end of file
@@ -2,8 +2,46 @@
 #include "Logger.h"
 #include "TcpConnection.h"
 
+#include "BufferAllocator.h"
+
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
 #include <strings.h>
 
+namespace
+{
+
+// 连接对象连同shared_ptr的控制块一次分配，内存来自BufferAllocator的大小类
+// 连接销毁后这块内存留在释放线程的缓存里，经中心链表回到mainLoop，给之后的连接复用
+template <typename T>
+struct ConnectionAllocator
+{
+    using value_type = T;
+
+    ConnectionAllocator() {}
+    template <typename U>
+    ConnectionAllocator(const ConnectionAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        size_t actualSize = 0;
+        return static_cast<T *>(BufferAllocator::allocate(n * sizeof(T), &actualSize));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        BufferAllocator::deallocate(p, BufferAllocator::allocationSize(n * sizeof(T)));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ConnectionAllocator<T> &, const ConnectionAllocator<U> &) { return true; }
+template <typename T, typename U>
+bool operator!=(const ConnectionAllocator<T> &, const ConnectionAllocator<U> &) { return false; }
+
+} // namespace
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
     if (loop == nullptr)
@@ -18,35 +56,79 @@ TcpServer::TcpServer(EventLoop *loop,
                      const std::string nameArg,
                      Option option)
     : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
-    , acceptor_(new Acceptor(loop, listenAddr, option == kNoReusePort))
+    , connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_ + "#"))
+    , acceptor_(option == kReusePortPerLoop ? nullptr : new Acceptor(loop, listenAddr, option == kReusePort))
     , threadPool_(new EventLoopThreadPool(loop, name_))
     , connectionCallback_()
     , messageCallback_()
     , nextConnId_(1)
     , started_(0)
+    , reusePortPerLoop_(option == kReusePortPerLoop)
+    , edgeTriggered_(false)
+    , idleSeconds_(0.0)
+    , bufferIdleSeconds_(0.0)
+    , bufferShrinkThreshold_(TcpConnection::kDefaultBufferShrinkThreshold)
+    , zeroCopyThreshold_(0)
+    , corked_(false)
 {
     // 当有用户连接时，会执行TcpServer::newConnection回调
-    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
-        std::placeholders::_1, std::placeholders::_2));
+    if (acceptor_)
+    {
+        acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
+            std::placeholders::_1, std::placeholders::_2));
+        acceptor_->setAcceptBatchCallback(std::bind(&TcpServer::flushAcceptedConnections, this));
+    }
 }
 
 TcpServer::~TcpServer()
 {
     LOG_INFO("TcpServer::~TcpServer \n");
 
-    for (auto& item : connections_)
+    // 先停掉各个loop的Acceptor，之后不会再有连接加入分片，也不会再回调this
+    stopLoopAcceptors();
+
+    // 分片和时间轮只能在所属的loop中访问，交给各个loop自己销毁
+    for (auto &item : connections_)
     {
-        TcpConnectionPtr conn(item.second);     // 局部的shared_ptr智能指针对象， 出作用域后可以自动释放资源
-        item.second.reset();
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn)
+        EventLoop *ioLoop = item.first;
+        std::shared_ptr<TimingWheel> idleWheel(idleWheels_.empty() ? nullptr : idleWheels_.find(ioLoop)->second);
+        std::shared_ptr<TimingWheel> bufferWheel(bufferWheels_.empty() ? nullptr : bufferWheels_.find(ioLoop)->second);
+        ioLoop->runInLoop(
+            std::bind(&TcpServer::destroyShard, item.second, idleWheel, bufferWheel)
         );
     }
 }
 
+// kReusePortPerLoop：Acceptor的Channel注册在所属的loop上，要在那个loop中析构
+// 同步等所有loop都析构完，Acceptor的回调绑定了this，TcpServer的成员析构之前不能再有新连接
+void TcpServer::stopLoopAcceptors()
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t pending = loopAcceptors_.size();
+    for (std::shared_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        EventLoop *ioLoop = acceptor->getLoop();
+        std::shared_ptr<Acceptor> stopping(std::move(acceptor));
+        // 当前线程就是ioLoop时（没有subLoop）直接执行
+        ioLoop->runInLoop([stopping, &mutex, &cond, &pending]() mutable {
+            stopping.reset();
+            std::unique_lock<std::mutex> lock(mutex);
+            --pending;
+            cond.notify_one();
+        });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    while (pending > 0)
+    {
+        cond.wait(lock);
+    }
+    loopAcceptors_.clear();
+}
+
 // 设置底层subLoop的个数
 void TcpServer::setThreadNum(int numThreads)
 {
@@ -59,7 +141,46 @@ void TcpServer::start()
     if (started_++ == 0)    // 防止一个TcpServer被启动多次
     {
         threadPool_->start(threadInitCallback_);    // 启动底层的loop线程池
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            connections_[ioLoop] = std::make_shared<ConnectionMap>();
+        }
+        if (idleSeconds_ > 0.0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel(new TimingWheel(ioLoop, idleSeconds_,
+                    std::bind(&TcpServer::evictIdleConnections, connections_[ioLoop], name_, std::placeholders::_1)));
+                wheel->start();
+                idleWheels_[ioLoop] = wheel;
+            }
+        }
+        if (bufferIdleSeconds_ > 0.0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel(new TimingWheel(ioLoop, bufferIdleSeconds_,
+                    &TcpServer::shrinkIdleBuffers));
+                wheel->start();
+                bufferWheels_[ioLoop] = wheel;
+            }
+        }
+        if (reusePortPerLoop_)
+        {
+            // 在这里bind，端口被占用时马上就能发现；listen之后Channel注册在ioLoop上，要在ioLoop中执行
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<Acceptor> acceptor(std::make_shared<Acceptor>(ioLoop, listenAddr_, true));
+                acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionInLoop, this, ioLoop,
+                    std::placeholders::_1, std::placeholders::_2));
+                ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+                loopAcceptors_.push_back(acceptor);
+            }
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
     }
 }
 
@@ -68,64 +189,203 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     // 轮询算法，选择一个subLoop，来管理channel
     EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
-
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-        name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
-    
-    // 通过sockfd获取其绑定的本机的ip地址和端口信息
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
-    {
-        LOG_ERROR("::getsockname error");
-    }
-    InetAddress localAddr(local);
-
-    // 根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(
+    // 先攒着，这一轮accept结束后再交给subLoop
+    acceptedConns_[ioLoop].push_back(createConnection(ioLoop, sockfd, peerAddr));
+}
+
+// 一轮accept结束，每个subLoop投递一次：在subLoop中加入分片，再调用TcpConnection::connectEstablished
+void TcpServer::flushAcceptedConnections()
+{
+    for (auto &item : acceptedConns_)
+    {
+        EventLoop *ioLoop = item.first;
+        std::vector<TcpConnectionPtr> &conns = item.second;
+        if (conns.empty())
+        {
+            continue;
+        }
+        ConnectionMap *shard = connections_.find(ioLoop)->second.get();
+        if (conns.size() == 1)
+        {
+            ioLoop->runInLoop(std::bind(&TcpServer::establishConnection, shard, conns.front()));
+        }
+        else
+        {
+            // 按实际大小拷出一份，conns留着容量给下一轮用
+            std::vector<TcpConnectionPtr> batch(std::make_move_iterator(conns.begin()), std::make_move_iterator(conns.end()));
+            ioLoop->runInLoop(std::bind(&TcpServer::establishConnections, shard, std::move(batch)));
+        }
+        conns.clear();
+    }
+}
+
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    establishConnection(connections_.find(ioLoop)->second.get(), createConnection(ioLoop, sockfd, peerAddr));
+}
+
+// 可能在mainLoop中执行，也可能（kReusePortPerLoop）在ioLoop中执行，只读start之后不再修改的成员
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    // 监听的是具体的IP和端口时，连接的本端地址就是监听地址，不用getsockname
+    InetAddress localAddr(listenAddr_);
+    const sockaddr_in *listen = listenAddr_.getSockAddr();
+    if (listen->sin_addr.s_addr == htonl(INADDR_ANY) || listen->sin_port == 0)
+    {
+        // 通过sockfd获取其绑定的本机的ip地址和端口信息
+        sockaddr_in local;
+        ::bzero(&local, sizeof local);
+        socklen_t addrlen = sizeof local;
+        if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
+        {
+            LOG_ERROR("::getsockname error");
+        }
+        localAddr.setSockAddr(local);
+    }
+
+    // 根据连接成功的sockfd，创建TcpConnection连接对象；名字等到用的时候再拼
+    const uint64_t connId = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+    TcpConnectionPtr conn(std::allocate_shared<TcpConnection>(
+                            ConnectionAllocator<TcpConnection>(),
                             ioLoop,
-                            connName,
+                            connId,
+                            connNamePrefix_,
                             sockfd,       ///< socket channel
                             localAddr,
                             peerAddr));
-    connections_[connName] = conn;
+    LOG_INFO("TcpServer::newConnection [%s] - new connection #%llu from %s \n",
+        name_.c_str(), (unsigned long long)connId, peerAddr.toIpPort().c_str());
+    ConnectionMap *shard = connections_.find(ioLoop)->second.get();
     // 下面的回调都是从用户那得到的
     // 用户 => TcpServer => TcpConnection => Channel => Poller => notify Channel执行回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    if (!idleWheels_.empty())
+    {
+        conn->setIdleWheel(idleWheels_.find(ioLoop)->second);
+    }
+    conn->setBufferShrink(bufferWheels_.empty() ? nullptr : bufferWheels_.find(ioLoop)->second, bufferShrinkThreshold_);
+    if (zeroCopyThreshold_ > 0)
+    {
+        conn->setZeroCopyThreshold(zeroCopyThreshold_);
+    }
+    conn->setCorked(corked_);
 
-    // 设置了如何关闭连接的回调
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
-    );
+    // 设置了如何关闭连接的回调，关闭直接在subLoop中完成
+    conn->setCloseCallback([shard](const TcpConnectionPtr &c) { removeConnection(shard, c); });
+    return conn;
+}
 
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(
-        std::bind(&TcpConnection::connectEstablished, conn)
-    );
+void TcpServer::establishConnection(ConnectionMap *shard, const TcpConnectionPtr &conn)
+{
+    (*shard)[conn->id()] = conn;
+    conn->connectEstablished();
+}
+
+void TcpServer::establishConnections(ConnectionMap *shard, const std::vector<TcpConnectionPtr> &conns)
+{
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        establishConnection(shard, conn);
+    }
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::removeConnection(ConnectionMap *shard, const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn)
+    LOG_INFO("TcpServer::removeConnection - connection #%llu from %s \n",
+        (unsigned long long)conn->id(), conn->peerAddress().toIpPort().c_str());
+
+    shard->erase(conn->id());
+    // 现在还在conn的handleClose中，等这一轮事件处理完再从poller中删除channel
+    conn->getLoop()->queueInLoop(
+        std::bind(&TcpConnection::connectDestroyed, conn)
     );
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+void TcpServer::destroyShard(const std::shared_ptr<ConnectionMap> &shard, const std::shared_ptr<TimingWheel> &idleWheel,
+                             const std::shared_ptr<TimingWheel> &bufferWheel)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s \n",
-        name_.c_str(), conn->getName().c_str());
+    // 时间轮还被连接持有，先停掉tick，之后不会再踢除或收缩连接
+    if (idleWheel)
+    {
+        idleWheel->stop();
+    }
+    if (bufferWheel)
+    {
+        bufferWheel->stop();
+    }
+    ConnectionMap conns;
+    conns.swap(*shard);
+    for (auto &item : conns)
+    {
+        item.second->connectDestroyed();
+    }
+}
 
-    connections_.erase(conn->getName());
-    EventLoop *ioLoop = conn->getLoop();
+void TcpServer::forEachConnection(const ConnectionVisitor &visit, const std::function<void()> &done)
+{
+    std::shared_ptr<std::atomic<int>> pending(std::make_shared<std::atomic<int>>(static_cast<int>(connections_.size())));
+    for (auto &item : connections_)
+    {
+        item.first->runInLoop(
+            std::bind(&TcpServer::visitShard, item.second, visit, pending, done)
+        );
+    }
+}
+
+void TcpServer::visitShard(const std::shared_ptr<ConnectionMap> &shard, const ConnectionVisitor &visit,
+                           const std::shared_ptr<std::atomic<int>> &pending, const std::function<void()> &done)
+{
+    // visit里可能关闭连接，先取一份快照，遍历时不受删除的影响
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(shard->size());
+    for (auto &item : *shard)
+    {
+        conns.push_back(item.second);
+    }
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        visit(conn);
+    }
+    if (pending->fetch_sub(1) == 1 && done)
+    {
+        done();
+    }
+}
+
+// 在subLoop中执行，conns是时间轮这一次tick超时的所有连接
+void TcpServer::evictIdleConnections(const std::shared_ptr<ConnectionMap> &shard, const std::string &name,
+                                     std::vector<TcpConnectionPtr> &conns)
+{
+    LOG_INFO("TcpServer::evictIdleConnections [%s] - %d idle connections \n",
+        name.c_str(), (int)conns.size());
+
+    // 同一批连接都属于同一个subLoop，就是当前的loop
+    EventLoop *ioLoop = conns.front()->getLoop();
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->closeIdleInLoop();
+        shard->erase(conn->id());
+    }
     ioLoop->queueInLoop(
-        std::bind(&TcpConnection::connectDestroyed, conn)
+        std::bind(&TcpServer::destroyConnections, conns)
     );
+}
+
+void TcpServer::destroyConnections(const std::vector<TcpConnectionPtr> &conns)
+{
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->connectDestroyed();
+    }
+}
+
+void TcpServer::shrinkIdleBuffers(std::vector<TcpConnectionPtr> &conns)
+{
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->shrinkBuffersInLoop();
+    }
 }
\ No newline at end of file
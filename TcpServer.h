@@ -8,24 +8,30 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "TimingWheel.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 // 对外服务器编程使用的类
 class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop *)>;
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>; ///< 以TcpConnection::id()为键
+    using ConnectionVisitor = std::function<void(const TcpConnectionPtr &)>;
 
     enum Option
     {
         kNoReusePort,
         kReusePort,
+        // 每个subLoop一个Acceptor，各自用SO_REUSEPORT监听同一端口，由内核把新连接分给各个loop
+        // 连接在接受它的loop里直接建立，不经过mainLoop
+        kReusePortPerLoop,
     };
 
     TcpServer(EventLoop *loop,
@@ -42,20 +48,69 @@ public:
     // 设置底层subLoop的个数
     void setThreadNum(int numThreads);
 
+    // 新连接使用epoll的边沿触发模式，必须在start之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 设置空闲连接的超时时间（秒），超过这个时间没有读事件的连接会被关闭，精度为1秒（一个tick），必须在start之前调用
+    void setIdleTimeout(double seconds) { idleSeconds_ = seconds; }
+
+    // 连接的inputBuffer读完之后，容量超过thresholdBytes的马上释放，
+    // 其余的空闲idleSeconds秒（精度为1秒）之后释放，idleSeconds<=0表示不按空闲时间释放，必须在start之前调用
+    void setBufferShrink(double idleSeconds, size_t thresholdBytes)
+    {
+        bufferIdleSeconds_ = idleSeconds;
+        bufferShrinkThreshold_ = thresholdBytes;
+    }
+
+    // 新连接的零拷贝发送阈值，见TcpConnection::setZeroCopyThreshold，必须在start之前调用
+    void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+
+    // 新连接是否使用攒包模式，见TcpConnection::setCorked，必须在start之前调用
+    void setCorked(bool on) { corked_ = on; }
+
+    // 遍历所有连接，线程安全：每个subLoop在自己的线程中对自己的连接调用visit，各个loop并行执行
+    // 所有loop都遍历完之后，在最后完成的那个loop线程中调用done（可以为空）；必须在start之后调用
+    void forEachConnection(const ConnectionVisitor &visit, const std::function<void()> &done = std::function<void()>());
+
+    // 线程池，可以用来遍历subLoop，查看每个loop的统计数据
+    std::shared_ptr<EventLoopThreadPool> threadPool() const { return threadPool_; }
+
     // 开启服务器监听
     void start();
 
 private:
     void newConnection(int sockfd, const InetAddress &peerAddr);
-    void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    void flushAcceptedConnections();
+    // kReusePortPerLoop模式下，ioLoop的Acceptor接受了新连接，在ioLoop中执行
+    void newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    void stopLoopAcceptors();
+    // 以下在连接所属的subLoop中执行，只访问这个loop的分片，不经过mainLoop
+    static void establishConnection(ConnectionMap *shard, const TcpConnectionPtr &conn);
+    static void establishConnections(ConnectionMap *shard, const std::vector<TcpConnectionPtr> &conns);
+    static void removeConnection(ConnectionMap *shard, const TcpConnectionPtr &conn);
+    static void destroyShard(const std::shared_ptr<ConnectionMap> &shard, const std::shared_ptr<TimingWheel> &idleWheel,
+                             const std::shared_ptr<TimingWheel> &bufferWheel);
+    static void visitShard(const std::shared_ptr<ConnectionMap> &shard, const ConnectionVisitor &visit,
+                           const std::shared_ptr<std::atomic<int>> &pending, const std::function<void()> &done);
+
+    // 空闲连接的批量删除：在subLoop中从分片里删除，再统一销毁
+    // 时间轮由连接共同持有，可能比TcpServer晚析构，回调只绑定分片和名字的拷贝，不绑定this
+    static void evictIdleConnections(const std::shared_ptr<ConnectionMap> &shard, const std::string &name,
+                                     std::vector<TcpConnectionPtr> &conns);
+    static void destroyConnections(const std::vector<TcpConnectionPtr> &conns);
+    // 在subLoop中执行，conns是缓冲区时间轮这一次tick空闲超时的连接
+    static void shrinkIdleBuffers(std::vector<TcpConnectionPtr> &conns);
 
     EventLoop *loop_; ///< baseLoop（用户定义的loop，acceptor loop）
 
+    const InetAddress listenAddr_;
     const std::string ipPort_;
     const std::string name_;
+    const std::shared_ptr<const std::string> connNamePrefix_; ///< name-ip:port#，所有连接共用
 
-    std::unique_ptr<Acceptor> acceptor_; ///< 运行在mainLoop，任务就是监听新连接事件
+    std::unique_ptr<Acceptor> acceptor_; ///< 运行在mainLoop，任务就是监听新连接事件；kReusePortPerLoop模式下为空
+    std::vector<std::shared_ptr<Acceptor>> loopAcceptors_; ///< kReusePortPerLoop模式下每个loop一个，析构时在各自的loop中同步停掉
 
     std::shared_ptr<EventLoopThreadPool> threadPool_; ///< one loop per thread
 
@@ -66,7 +121,26 @@ private:
     ThreadInitCallback threadInitCallback_; ///< loop初始化的回调
 
     std::atomic_int started_;
-
-    int nextConnId_;
-    ConnectionMap connections_; ///< 保存所有的连接
+    const bool reusePortPerLoop_;
+
+    std::atomic<uint64_t> nextConnId_; ///< kReusePortPerLoop模式下各个loop都会分配
+    /**
+     * 连接按subLoop分片保存，分片只在所属的loop中访问，连接的建立和关闭都在自己的loop里完成
+     * start时为每个loop建好分片，之后这个map本身只读，任何线程都可以查找
+     * 分片用shared_ptr，TcpServer析构时投递到各个loop的销毁任务持有它
+     */
+    std::unordered_map<EventLoop *, std::shared_ptr<ConnectionMap>> connections_;
+    // 这一轮accept得到的新连接，按subLoop分组，一轮结束后每个subLoop只投递一次，只在mainLoop中访问
+    std::unordered_map<EventLoop *, std::vector<TcpConnectionPtr>> acceptedConns_;
+
+    bool edgeTriggered_;
+    double idleSeconds_; ///< <=0 表示不踢除空闲连接
+    std::unordered_map<EventLoop *, std::shared_ptr<TimingWheel>> idleWheels_; ///< 每个subLoop一个时间轮，start之后只读
+
+    double bufferIdleSeconds_; ///< <=0 表示不按空闲时间释放缓冲区
+    size_t bufferShrinkThreshold_;
+    std::unordered_map<EventLoop *, std::shared_ptr<TimingWheel>> bufferWheels_; ///< 同idleWheels_
+
+    size_t zeroCopyThreshold_; ///< 0 表示不使用零拷贝发送
+    bool corked_;
 };
\ No newline at end of file
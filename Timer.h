@@ -0,0 +1,47 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+// 定时器对象，由TimerQueue管理生命周期
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++numCreated_)
+        , heapIndex_(-1)
+    {
+    }
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 周期定时器重新计算下一次的超时时间
+    void restart(Timestamp now);
+
+    // 在TimerQueue堆数组中的下标，-1表示不在堆中
+    int heapIndex() const { return heapIndex_; }
+    void setHeapIndex(int idx) { heapIndex_ = idx; }
+
+    static int64_t numCreated() { return numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;
+    const bool repeat_;
+    const int64_t sequence_; ///< 全局唯一的序号，用来区分地址被复用的Timer
+    int heapIndex_;
+
+    static std::atomic<int64_t> numCreated_;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// 给用户使用的定时器句柄，可以拷贝，用来取消定时器
+// 只保存Timer的序号，TimerQueue通过序号查找Timer，不会访问已经释放的Timer
+class TimerId
+{
+public:
+    TimerId()
+        : sequence_(0)
+    {
+    }
+
+    explicit TimerId(int64_t seq)
+        : sequence_(seq)
+    {
+    }
+
+    bool valid() const { return sequence_ > 0; }
+
+    friend class TimerQueue;
+
+private:
+    int64_t sequence_;
+};
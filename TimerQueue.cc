@@ -0,0 +1,251 @@
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+// 正在执行回调的定时器被取消了，用heapIndex标记，在reset中释放
+static const int kCanceled = -2;
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+// 把绝对时间转换成timerfd_settime需要的相对时间
+static struct timespec howMuchTimeFromNow(Timestamp when)
+{
+    int64_t microseconds = when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+    if (microseconds < 100)
+    {
+        microseconds = 100;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+
+static void readTimerfd(int timerfd)
+{
+    uint64_t howmany = 0;
+    ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %d bytes instead of 8\n", (int)n);
+    }
+}
+
+static void resetTimerfd(int timerfd, Timestamp expiration)
+{
+    struct itimerspec newValue;
+    memset(&newValue, 0, sizeof newValue);
+    newValue.it_value = howMuchTimeFromNow(expiration);
+    if (::timerfd_settime(timerfd, 0, &newValue, nullptr) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+
+    for (const Entry &entry : heap_)
+    {
+        delete entry.timer;
+    }
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    Timer *timer = new Timer(std::move(cb), when, interval);
+    // 跨线程调用时，timer可能在返回之前就已经被loop线程执行并释放了，先把序号取出来
+    TimerId timerId(timer->sequence());
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return timerId;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer)
+{
+    activeTimers_[timer->sequence()] = timer;
+    if (insert(timer))
+    {
+        // 新插入的定时器是最早超时的，需要重新设置timerfd
+        resetTimerfd(timerfd_, timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    auto it = activeTimers_.find(timerId.sequence_);
+    if (it == activeTimers_.end())
+    {
+        return; // 已经执行完或者已经取消了
+    }
+
+    Timer *timer = it->second;
+    activeTimers_.erase(it);
+    if (timer->heapIndex() >= 0)
+    {
+        removeAt(timer->heapIndex());
+        delete timer;
+    }
+    else
+    {
+        // 在自己（或同一批超时的）回调里取消，此时timer在expired_中，交给reset释放
+        timer->setHeapIndex(kCanceled);
+    }
+    // 被取消的如果是堆顶，timerfd多触发一次也没关系，handleRead里会重新设置
+}
+
+void TimerQueue::handleRead()
+{
+    Timestamp now(loop_->pollReturnTime());
+    readTimerfd(timerfd_);
+
+    getExpired(now);
+    for (Timer *timer : expired_)
+    {
+        if (timer->heapIndex() != kCanceled)
+        {
+            timer->run();
+        }
+    }
+    reset(now);
+}
+
+void TimerQueue::getExpired(Timestamp now)
+{
+    while (!heap_.empty() && heap_.front().expiration <= now.microSecondsSinceEpoch())
+    {
+        Timer *timer = heap_.front().timer;
+        removeAt(0);
+        expired_.push_back(timer);
+    }
+}
+
+void TimerQueue::reset(Timestamp now)
+{
+    for (Timer *timer : expired_)
+    {
+        if (timer->heapIndex() != kCanceled && timer->repeat())
+        {
+            timer->restart(now);
+            insert(timer);
+        }
+        else
+        {
+            if (timer->heapIndex() != kCanceled)
+            {
+                activeTimers_.erase(timer->sequence());
+            }
+            delete timer;
+        }
+    }
+    expired_.clear();
+
+    if (!heap_.empty())
+    {
+        resetTimerfd(timerfd_, Timestamp(heap_.front().expiration));
+    }
+}
+
+bool TimerQueue::insert(Timer *timer)
+{
+    Entry entry = {timer->expiration().microSecondsSinceEpoch(), timer};
+    heap_.push_back(entry);
+    timer->setHeapIndex(static_cast<int>(heap_.size() - 1));
+    siftUp(heap_.size() - 1);
+    return timer->heapIndex() == 0;
+}
+
+// 用最后一个元素填补index的位置，再向上或向下调整
+void TimerQueue::removeAt(size_t index)
+{
+    heap_[index].timer->setHeapIndex(-1);
+    size_t last = heap_.size() - 1;
+    if (index != last)
+    {
+        place(index, heap_[last]);
+        heap_.pop_back();
+        siftDown(index);
+        siftUp(index);
+    }
+    else
+    {
+        heap_.pop_back();
+    }
+}
+
+void TimerQueue::siftUp(size_t index)
+{
+    Entry entry = heap_[index];
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (heap_[parent].expiration <= entry.expiration)
+        {
+            break;
+        }
+        place(index, heap_[parent]);
+        index = parent;
+    }
+    place(index, entry);
+}
+
+void TimerQueue::siftDown(size_t index)
+{
+    Entry entry = heap_[index];
+    size_t size = heap_.size();
+    while (true)
+    {
+        size_t child = 2 * index + 1;
+        if (child >= size)
+        {
+            break;
+        }
+        if (child + 1 < size && heap_[child + 1].expiration < heap_[child].expiration)
+        {
+            ++child;
+        }
+        if (entry.expiration <= heap_[child].expiration)
+        {
+            break;
+        }
+        place(index, heap_[child]);
+        index = child;
+    }
+    place(index, entry);
+}
+
+void TimerQueue::place(size_t index, const Entry &entry)
+{
+    heap_[index] = entry;
+    entry.timer->setHeapIndex(static_cast<int>(index));
+}
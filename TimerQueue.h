@@ -0,0 +1,66 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <vector>
+#include <unordered_map>
+
+class EventLoop;
+class Timer;
+
+/**
+ * 定时器队列，每个EventLoop一个
+ * timerfd => timerfdChannel => Poller，和其他fd一样走统一事件源
+ * 底层是一个数组实现的二叉小根堆，堆里只存 超时时间 + Timer指针，比较的时候不需要访问Timer对象
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全，可以跨线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+    size_t size() const { return heap_.size(); }
+
+private:
+    struct Entry
+    {
+        int64_t expiration; ///< 超时时间（微秒），拷贝一份在堆里，比较时不用解引用Timer
+        Timer *timer;
+    };
+
+    using ActiveTimerMap = std::unordered_map<int64_t, Timer *>; ///< key：Timer的序号
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    // timerfd可读的回调，执行所有超时的定时器
+    void handleRead();
+
+    // 把所有超时的定时器从堆中取出，放到expired_中
+    void getExpired(Timestamp now);
+    // 重新插入周期定时器，释放一次性的定时器，并重新设置timerfd
+    void reset(Timestamp now);
+
+    // 堆操作，返回true表示堆顶（最早的超时时间）发生了变化
+    bool insert(Timer *timer);
+    void removeAt(size_t index);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void place(size_t index, const Entry &entry);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    std::vector<Entry> heap_;      ///< 按超时时间排序的小根堆
+    ActiveTimerMap activeTimers_;  ///< 所有还没有被取消或释放的定时器，取消时通过序号查找
+    std::vector<Timer *> expired_; ///< 本次超时的定时器，复用内存
+};
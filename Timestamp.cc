@@ -1,7 +1,30 @@
 #include "Timestamp.h"
 
 #include <time.h>
-#include <stdio.h>
+#include <string.h>
+
+static const int kSecondsStrLen = 19; ///< "YYYY/MM/DD HH:MM:SS"
+
+// 每个线程缓存上一次格式化的秒数和结果，日志同一秒内的时间前缀不用重新计算
+static __thread time_t t_lastSecond = -1;
+static __thread char t_secondsStr[kSecondsStrLen];
+
+// 定宽写width位十进制数，高位补0，超出的高位丢掉，输出长度固定
+static void formatDigits(char *buf, int value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+    {
+        buf[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+}
+
+static Timestamp clockNow(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
 
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 
@@ -10,22 +33,61 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    return clockNow(CLOCK_REALTIME);
+}
+
+Timestamp Timestamp::monotonicNow()
+{
+    return clockNow(CLOCK_MONOTONIC);
+}
+
+Timestamp Timestamp::coarseMonotonicNow()
+{
+    return clockNow(CLOCK_MONOTONIC_COARSE);
 }
 
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-
-    return buf;
+    char buf[kFormattedSize];
+    int len = formatTo(buf, false);
+    return std::string(buf, len);
+}
+
+int Timestamp::formatTo(char *buf, bool showMicroseconds) const
+{
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    if (seconds != t_lastSecond)
+    {
+        // localtime不是线程安全的，而且每次调用都会重新检查时区文件
+        tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        // 年份限制在0000~9999，保证正好kSecondsStrLen个字符
+        int year = tm_time.tm_year + 1900;
+        formatDigits(t_secondsStr, year < 0 ? 0 : (year > 9999 ? 9999 : year), 4);
+        t_secondsStr[4] = '/';
+        formatDigits(t_secondsStr + 5, tm_time.tm_mon + 1, 2);
+        t_secondsStr[7] = '/';
+        formatDigits(t_secondsStr + 8, tm_time.tm_mday, 2);
+        t_secondsStr[10] = ' ';
+        formatDigits(t_secondsStr + 11, tm_time.tm_hour, 2);
+        t_secondsStr[13] = ':';
+        formatDigits(t_secondsStr + 14, tm_time.tm_min, 2);
+        t_secondsStr[16] = ':';
+        formatDigits(t_secondsStr + 17, tm_time.tm_sec, 2);
+        t_lastSecond = seconds;
+    }
+
+    memcpy(buf, t_secondsStr, kSecondsStrLen);
+    int len = kSecondsStrLen;
+    if (showMicroseconds)
+    {
+        int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        buf[len] = '.';
+        formatDigits(buf + len + 1, microseconds < 0 ? -microseconds : microseconds, 6);
+        len += 7;
+    }
+    buf[len] = '\0';
+    return len;
 }
 
 // #include <iostream>
@@ -34,4 +96,4 @@ std::string Timestamp::toString() const
 //     std::cout << Timestamp::now().toString() << std::endl;
 
 //     return 0;
-// }
\ No newline at end of file
+// }
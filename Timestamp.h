@@ -4,15 +4,57 @@
 #include <string>
 #include <stdint.h>
 
-// 日志类
+// 时间戳，微秒精度
 class Timestamp
 {
 public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
+
+    // 墙上时间（CLOCK_REALTIME），可以格式化输出
     static Timestamp now();
+    // 单调时间，不受系统时间调整的影响，只能用来计算时间差
+    static Timestamp monotonicNow();
+    // 粗粒度的单调时间（CLOCK_MONOTONIC_COARSE），精度为一个jiffy（1~4ms），但比monotonicNow更快
+    static Timestamp coarseMonotonicNow();
+
     std::string toString() const;
+    // 格式化到调用方的缓冲区，不分配内存，buf至少要有kFormattedSize个字节，返回写入的长度
+    // 同一秒内复用线程缓存的 "YYYY/MM/DD HH:MM:SS" 部分，只有跨秒时才调用localtime_r
+    int formatTo(char *buf, bool showMicroseconds) const;
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static Timestamp invalid() { return Timestamp(); }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+    static const int kFormattedSize = 32;
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间戳相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上加seconds秒，定时器计算超时时间用
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
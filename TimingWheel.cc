@@ -0,0 +1,161 @@
+#include "TimingWheel.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+
+#include <math.h>
+
+TimingWheel::TimingWheel(EventLoop *loop, double idleSeconds, const ExpiredCallback &cb)
+    : loop_(loop)
+    , tickSeconds_(idleSeconds < 1.0 ? idleSeconds : 1.0)
+    , timeoutTicks_(static_cast<int64_t>(ceil(idleSeconds / tickSeconds_)))
+    , expiredCallback_(cb)
+    , currentTick_(0)
+    , size_(0)
+{
+    // 空的链表头指向自己
+    for (Entry &head : level0_)
+    {
+        head.prev = head.next = &head;
+    }
+    for (Entry &head : level1_)
+    {
+        head.prev = head.next = &head;
+    }
+}
+
+void TimingWheel::start()
+{
+    // 定时器只持有weak_ptr，TimingWheel析构后不会再被回调
+    std::weak_ptr<TimingWheel> weakWheel(shared_from_this());
+    timerId_ = loop_->runEvery(tickSeconds_, [weakWheel]() {
+        std::shared_ptr<TimingWheel> wheel(weakWheel.lock());
+        if (wheel)
+        {
+            wheel->onTick();
+        }
+    });
+}
+
+void TimingWheel::stop()
+{
+    loop_->cancel(timerId_);
+    // 回调可能持有TcpServer的分片，分片里的连接又持有时间轮，在这里断开
+    expiredCallback_ = ExpiredCallback();
+}
+
+void TimingWheel::add(Entry *entry)
+{
+    if (!entry->linked())
+    {
+        ++size_;
+    }
+    else
+    {
+        unlink(entry);
+    }
+    entry->lastActiveTick = currentTick_;
+    schedule(entry, currentTick_ + timeoutTicks_);
+}
+
+void TimingWheel::remove(Entry *entry)
+{
+    if (entry->linked())
+    {
+        unlink(entry);
+        --size_;
+    }
+}
+
+// 根据离到期还有多少个tick，决定挂在哪一层的哪个槽上
+void TimingWheel::schedule(Entry *entry, int64_t deadline)
+{
+    if (deadline <= currentTick_)
+    {
+        deadline = currentTick_ + 1;
+    }
+
+    int64_t delta = deadline - currentTick_;
+    if (delta < kLevel0Size)
+    {
+        link(&level0_[deadline & (kLevel0Size - 1)], entry);
+    }
+    else
+    {
+        // 第1层的槽号最多比当前槽号大kLevel1Size-1，否则会和当前槽重叠
+        int64_t maxDelta = static_cast<int64_t>(kLevel0Size) * (kLevel1Size - 1);
+        if (delta >= maxDelta)
+        {
+            deadline = currentTick_ + maxDelta;
+        }
+        link(&level1_[(deadline >> kLevel0Bits) & (kLevel1Size - 1)], entry);
+    }
+}
+
+// 第0层转完一圈，把第1层当前槽里的节点重新分配到第0层
+void TimingWheel::cascade()
+{
+    Entry *head = &level1_[(currentTick_ >> kLevel0Bits) & (kLevel1Size - 1)];
+    while (head->next != head)
+    {
+        Entry *entry = head->next;
+        unlink(entry);
+        int64_t deadline = entry->lastActiveTick + timeoutTicks_;
+        if (deadline <= currentTick_)
+        {
+            // 正好在这个tick到期：挂到当前槽上，onTick接下来就会处理（schedule会把它推迟一个tick）
+            link(&level0_[currentTick_ & (kLevel0Size - 1)], entry);
+        }
+        else
+        {
+            schedule(entry, deadline);
+        }
+    }
+}
+
+void TimingWheel::onTick()
+{
+    ++currentTick_;
+    if ((currentTick_ & (kLevel0Size - 1)) == 0)
+    {
+        cascade();
+    }
+
+    Entry *head = &level0_[currentTick_ & (kLevel0Size - 1)];
+    while (head->next != head)
+    {
+        Entry *entry = head->next;
+        unlink(entry);
+
+        int64_t deadline = entry->lastActiveTick + timeoutTicks_;
+        if (deadline > currentTick_)
+        {
+            schedule(entry, deadline); // 期间有过读事件，顺延
+        }
+        else
+        {
+            --size_;
+            expired_.push_back(entry->conn->shared_from_this());
+        }
+    }
+
+    if (!expired_.empty())
+    {
+        expiredCallback_(expired_);
+        expired_.clear();
+    }
+}
+
+void TimingWheel::link(Entry *head, Entry *entry)
+{
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+void TimingWheel::unlink(Entry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = entry->next = nullptr;
+}
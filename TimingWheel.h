@@ -0,0 +1,83 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <stdint.h>
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 分层时间轮，每个subLoop一个，用来踢掉空闲连接
+ * 第0层256个槽，每槽一个tick；第1层64个槽，每槽256个tick，超出范围的先放在第1层最远的槽里
+ * touch只记录最近活跃的tick，O(1)且不用移动链表节点；到期时再检查一次，没超时的重新挂到轮子上
+ * 只能在所属loop线程中使用；由TcpServer和TcpConnection通过shared_ptr共同持有
+ * 连接可能比loop晚析构，析构函数不访问loop，tick定时器由TcpServer析构时在loop中调用stop取消
+ */
+class TimingWheel : noncopyable, public std::enable_shared_from_this<TimingWheel>
+{
+public:
+    // 嵌在TcpConnection里的侵入式链表节点，不需要额外分配内存
+    struct Entry
+    {
+        Entry()
+            : prev(nullptr)
+            , next(nullptr)
+            , conn(nullptr)
+            , lastActiveTick(0)
+        {
+        }
+
+        bool linked() const { return prev != nullptr; }
+
+        Entry *prev;
+        Entry *next;
+        TcpConnection *conn;
+        int64_t lastActiveTick;
+    };
+
+    using ExpiredCallback = std::function<void(std::vector<TcpConnectionPtr> &)>;
+
+    TimingWheel(EventLoop *loop, double idleSeconds, const ExpiredCallback &cb);
+
+    // 启动tick定时器，线程安全，必须在被shared_ptr管理之后调用
+    void start();
+    // 取消tick定时器并释放回调，之后不会再有连接超时，在loop线程中调用
+    void stop();
+
+    void add(Entry *entry);
+    void remove(Entry *entry);
+    // 连接上有数据可读时调用
+    void touch(Entry *entry) { entry->lastActiveTick = currentTick_; }
+
+    size_t size() const { return size_; }
+
+private:
+    static const int kLevel0Bits = 8;
+    static const int kLevel0Size = 1 << kLevel0Bits;
+    static const int kLevel1Size = 64;
+
+    void onTick();
+    void schedule(Entry *entry, int64_t deadline);
+    void cascade();
+
+    static void link(Entry *head, Entry *entry);
+    static void unlink(Entry *entry);
+
+    EventLoop *loop_;
+    const double tickSeconds_;
+    const int64_t timeoutTicks_;
+    ExpiredCallback expiredCallback_;
+    TimerId timerId_;
+
+    int64_t currentTick_;
+    size_t size_;
+    Entry level0_[kLevel0Size]; ///< 链表头（哨兵节点）
+    Entry level1_[kLevel1Size];
+    std::vector<TcpConnectionPtr> expired_; ///< 本次tick超时的连接，批量交给回调
+};
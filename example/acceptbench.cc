@@ -0,0 +1,244 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * accept压测，两部分：
+ * 1. 突发建连：客户端每一波同时发起wave个非阻塞connect，全部连上后用RST关闭，
+ *    统计mainLoop每个连接的poll轮数（拦截epoll_wait，只数mainLoop线程的）和CPU时间
+ * 2. fd耗尽：把进程的RLIMIT_NOFILE压到只剩kHeadroom个空闲fd，子进程一次连上kFloodConns个连接，
+ *    统计被服务端直接关闭（预留fd腾位置后接受再关闭）的连接数，以及这段时间mainLoop的CPU占用（不应该空转）
+ * 用法：./acceptbench [连接数] [每波连接数] [subLoop数]
+ */
+
+static const uint16_t kPort = 9993;
+static const int kHeadroom = 16;
+static const int kFloodConns = 200;
+
+static pthread_t g_mainThread;
+static std::atomic<int64_t> g_mainPolls(0);
+
+extern "C" int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    static auto real = reinterpret_cast<int (*)(int, struct epoll_event *, int, int)>(dlsym(RTLD_NEXT, "epoll_wait"));
+    if (pthread_equal(pthread_self(), g_mainThread))
+    {
+        g_mainPolls.fetch_add(1, std::memory_order_relaxed);
+    }
+    return real(epfd, events, maxevents, timeout);
+}
+
+static double threadCpuSeconds(pthread_t thread)
+{
+    clockid_t cid;
+    pthread_getcpuclockid(thread, &cid);
+    struct timespec ts;
+    ::clock_gettime(cid, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static sockaddr_in serverAddr()
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    return addr;
+}
+
+// 同时发起count个非阻塞connect，等全部连上后返回这些fd
+static std::vector<int> connectWave(int count)
+{
+    sockaddr_in addr = serverAddr();
+    std::vector<struct pollfd> fds(count);
+    for (int i = 0; i < count; ++i)
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0 && errno != EINPROGRESS)
+        {
+            perror("connect");
+            exit(1);
+        }
+        fds[i].fd = sockfd;
+        fds[i].events = POLLOUT;
+    }
+    std::vector<int> result;
+    for (int pending = count; pending > 0;)
+    {
+        ::poll(fds.data(), fds.size(), 1000);
+        for (struct pollfd &pfd : fds)
+        {
+            if (pfd.fd >= 0 && pfd.revents != 0)
+            {
+                int err = 0;
+                socklen_t len = sizeof err;
+                ::getsockopt(pfd.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0)
+                {
+                    fprintf(stderr, "connect: %s\n", strerror(err));
+                    exit(1);
+                }
+                result.push_back(pfd.fd);
+                pfd.fd = -1;
+                --pending;
+            }
+        }
+    }
+    return result;
+}
+
+// 子进程：等父进程的信号，连上kFloodConns个连接，1.5秒后数一数有多少被服务端关闭了，结果写回父进程
+static void floodClient(int goFd, int resultFd)
+{
+    char go;
+    if (::read(goFd, &go, 1) != 1)
+    {
+        _exit(1);
+    }
+    std::vector<int> fds(connectWave(kFloodConns));
+    ::usleep(1500 * 1000);
+    int closed = 0;
+    for (int sockfd : fds)
+    {
+        char buf[16];
+        ssize_t n = ::recv(sockfd, buf, sizeof buf, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            ++closed;
+        }
+        ::close(sockfd);
+    }
+    ::write(resultFd, &closed, sizeof closed);
+    _exit(0);
+}
+
+static int countOpenFds()
+{
+    int count = 0;
+    DIR *dir = ::opendir("/proc/self/fd");
+    if (dir == nullptr)
+    {
+        return -1;
+    }
+    while (::readdir(dir) != nullptr)
+    {
+        ++count;
+    }
+    ::closedir(dir);
+    return count - 3; // "." ".." 以及opendir自己的fd
+}
+
+int main(int argc, char *argv[])
+{
+    int numConns = argc > 1 ? atoi(argv[1]) : 20000;
+    int wave = argc > 2 ? atoi(argv[2]) : 512;
+    int numLoops = argc > 3 ? atoi(argv[3]) : 4;
+
+    // 在起任何线程之前fork出fd耗尽测试的客户端
+    int goPipe[2];
+    int resultPipe[2];
+    if (::pipe(goPipe) < 0 || ::pipe(resultPipe) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        floodClient(goPipe[0], resultPipe[1]);
+    }
+
+    Logger::setLogLevel(FATAL); // RST关闭的连接会报ECONNRESET，fd耗尽时每轮也会报一次，不打印
+    g_mainThread = pthread_self();
+    std::atomic<int> established(0);
+    std::atomic<int> destroyed(0);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort, "127.0.0.1"), "acceptbench");
+    server.setThreadNum(numLoops);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            established.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            destroyed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    std::thread client([&]() {
+        // 1. 突发建连
+        const int total = numConns / wave * wave;
+        int64_t polls = g_mainPolls.load();
+        double cpuStart = threadCpuSeconds(g_mainThread);
+        Timestamp start(Timestamp::monotonicNow());
+        struct linger lin = {1, 0};
+        for (int done = 0; done < total; done += wave)
+        {
+            for (int sockfd : connectWave(wave))
+            {
+                ::setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+                ::close(sockfd);
+            }
+        }
+        while (destroyed.load() < total)
+        {
+            ::usleep(1000);
+        }
+        double seconds = timeDifference(Timestamp::monotonicNow(), start);
+        double cpu = threadCpuSeconds(g_mainThread) - cpuStart;
+        polls = g_mainPolls.load() - polls;
+        printf("burst: %d connections in waves of %d, %d subLoops: %.0f conn/s, mainLoop %.3f polls/conn, "
+               "%.2f us/conn%s\n",
+               total, wave, numLoops, total / seconds, static_cast<double>(polls) / total, cpu * 1e6 / total,
+               established.load() == total ? "" : "  ESTABLISHED MISMATCH");
+        fflush(stdout);
+
+        // 2. fd耗尽
+        struct rlimit limit;
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = countOpenFds() + kHeadroom;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        int before = established.load();
+        cpuStart = threadCpuSeconds(g_mainThread);
+        start = Timestamp::monotonicNow();
+        ::write(goPipe[1], "g", 1);
+        int closed = -1;
+        ::read(resultPipe[0], &closed, sizeof closed);
+        seconds = timeDifference(Timestamp::monotonicNow(), start);
+        cpu = threadCpuSeconds(g_mainThread) - cpuStart;
+        printf("fd limit: %d connections with %d spare fds: %d established, %d closed by server, "
+               "mainLoop cpu %.0f%% over %.2f s\n",
+               kFloodConns, kHeadroom, established.load() - before, closed, cpu * 100 / seconds, seconds);
+        fflush(stdout);
+        loop.queueInLoop([&]() { loop.quit(); });
+    });
+
+    loop.loop();
+    client.join();
+    ::waitpid(child, nullptr, 0);
+    return 0;
+}
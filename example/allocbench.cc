@@ -0,0 +1,334 @@
+#include <mymuduo/BufferAllocator.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// 缓冲区分配器基准：模拟连接的建立/断开和大小混合的消息
+// 每个线程维护一批连接，每个连接一个inputBuffer和一个outputBuffer，按Buffer的方式翻倍扩容，清空时超过64KB的释放
+// 消息大小：80% 64-512B，15% 1-8KB，5% 16-128KB；连接随机断开，1/4的缓冲区交给下一个线程释放
+// 两种模式各fork一个子进程运行，互不影响RSS：
+// pool   : BufferAllocator
+// malloc : malloc/free
+// 统计：ops/s，峰值RSS，运行结束和关闭90%连接之后的RSS、堆内存和碎片率（1 - 在用字节 / malloc持有的堆内存）
+// 用法：./allocbench [线程数] [每线程连接数] [每线程操作数]
+
+static const size_t kInitialSize = 1024;
+static const size_t kShrinkThreshold = 64 * 1024;
+
+struct Slot
+{
+    char *data;
+    size_t capacity; ///< 分配器实际给出的大小
+    size_t request;  ///< 请求的大小，计入在用字节
+    size_t readable;
+};
+
+class Alloc
+{
+public:
+    explicit Alloc(bool pool) : pool_(pool) {}
+
+    char *allocate(size_t size, size_t *actualSize)
+    {
+        if (pool_)
+        {
+            return static_cast<char *>(BufferAllocator::allocate(size, actualSize));
+        }
+        *actualSize = size;
+        return static_cast<char *>(::malloc(size));
+    }
+
+    void deallocate(char *p, size_t actualSize)
+    {
+        if (pool_)
+        {
+            BufferAllocator::deallocate(p, actualSize);
+        }
+        else
+        {
+            ::free(p);
+        }
+    }
+
+private:
+    bool pool_;
+};
+
+struct Conn
+{
+    Slot input;
+    Slot output;
+};
+
+struct Handoff
+{
+    std::mutex mutex;
+    std::vector<Slot> slots;
+};
+
+struct Worker
+{
+    std::vector<Conn> conns;
+    int64_t liveBytes = 0;
+    int64_t ops = 0;
+};
+
+static size_t messageSize(std::mt19937 &rng)
+{
+    unsigned r = rng() % 100;
+    if (r < 80)
+    {
+        return 64 + rng() % 448;
+    }
+    else if (r < 95)
+    {
+        return 1024 + rng() % (7 * 1024);
+    }
+    return 16 * 1024 + rng() % (112 * 1024);
+}
+
+// 和Buffer::makeSpace一样：第一次分配max(len, kInitialSize)，不够时翻倍
+static void append(Alloc &alloc, Slot &slot, size_t len, int64_t *liveBytes)
+{
+    size_t need = slot.readable + len;
+    if (slot.data == nullptr || need > slot.capacity)
+    {
+        size_t request = slot.data == nullptr ? std::max(len, kInitialSize) : std::max(need, slot.capacity * 2);
+        size_t actual = 0;
+        char *data = alloc.allocate(request, &actual);
+        if (slot.data != nullptr)
+        {
+            memcpy(data, slot.data, slot.readable);
+            alloc.deallocate(slot.data, slot.capacity);
+        }
+        *liveBytes += static_cast<int64_t>(request) - static_cast<int64_t>(slot.request);
+        slot.data = data;
+        slot.capacity = actual;
+        slot.request = request;
+    }
+    memset(slot.data + slot.readable, 'x', len);
+    slot.readable = need;
+}
+
+static void release(Alloc &alloc, Slot &slot)
+{
+    if (slot.data != nullptr)
+    {
+        alloc.deallocate(slot.data, slot.capacity);
+        slot = Slot{nullptr, 0, 0, 0};
+    }
+}
+
+static void drainHandoff(Alloc &alloc, Handoff &handoff)
+{
+    std::vector<Slot> slots;
+    {
+        std::lock_guard<std::mutex> lock(handoff.mutex);
+        slots.swap(handoff.slots);
+    }
+    for (Slot &slot : slots)
+    {
+        release(alloc, slot);
+    }
+}
+
+// 断开一个连接，1/4的缓冲区交给下一个线程释放
+static void closeConn(Alloc &alloc, Conn &conn, Worker &worker, Handoff &next, std::mt19937 &rng)
+{
+    worker.liveBytes -= conn.input.request + conn.output.request;
+    Slot *slots[2] = {&conn.input, &conn.output};
+    for (Slot *slot : slots)
+    {
+        if (slot->data != nullptr && rng() % 4 == 0)
+        {
+            std::lock_guard<std::mutex> lock(next.mutex);
+            next.slots.push_back(*slot);
+            *slot = Slot{nullptr, 0, 0, 0};
+        }
+        else
+        {
+            release(alloc, *slot);
+        }
+    }
+}
+
+static void runChurn(Alloc &alloc, Worker &worker, Handoff &mine, Handoff &next, int numOps, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    for (int i = 0; i < numOps; ++i)
+    {
+        Conn &conn = worker.conns[rng() % worker.conns.size()];
+        unsigned r = rng() % 100;
+        if (r < 5)
+        {
+            closeConn(alloc, conn, worker, next, rng);
+        }
+        else if (r < 55)
+        {
+            append(alloc, conn.input, messageSize(rng), &worker.liveBytes);
+        }
+        else if (r < 90)
+        {
+            append(alloc, conn.output, messageSize(rng), &worker.liveBytes);
+        }
+        else
+        {
+            // 消息处理完，缓冲区清空；和TcpConnection的缓冲区回收一样，超过阈值的直接释放
+            Slot *slots[2] = {&conn.input, &conn.output};
+            for (Slot *slot : slots)
+            {
+                slot->readable = 0;
+                if (slot->capacity > kShrinkThreshold)
+                {
+                    worker.liveBytes -= slot->request;
+                    release(alloc, *slot);
+                }
+            }
+        }
+        if ((i & 63) == 0)
+        {
+            drainHandoff(alloc, mine);
+        }
+        ++worker.ops;
+    }
+}
+
+static void closeMost(Alloc &alloc, Worker &worker, Handoff &mine, Handoff &next, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    for (size_t i = 0; i < worker.conns.size(); ++i)
+    {
+        if (i % 10 != 0)
+        {
+            closeConn(alloc, worker.conns[i], worker, next, rng);
+        }
+    }
+    drainHandoff(alloc, mine);
+}
+
+static long currentRssKB()
+{
+    long pages = 0, rss = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+    {
+        if (fscanf(fp, "%ld %ld", &pages, &rss) != 2)
+        {
+            rss = 0;
+        }
+        fclose(fp);
+    }
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void report(const char *mode, const char *phase, const std::vector<Worker> &workers)
+{
+    int64_t live = 0;
+    for (const Worker &w : workers)
+    {
+        live += w.liveBytes;
+    }
+    struct mallinfo2 mi = mallinfo2();
+    size_t heap = mi.arena + mi.hblkhd;
+    printf("%-6s %-16s live %9.1f MB  heap %9.1f MB  rss %9.1f MB  frag %5.1f%%",
+           mode, phase, live / 1048576.0, heap / 1048576.0, currentRssKB() / 1024.0,
+           heap > 0 ? 100.0 * (1.0 - static_cast<double>(live) / heap) : 0.0);
+    if (strcmp(mode, "pool") == 0)
+    {
+        BufferAllocator::Stats stats = BufferAllocator::stats();
+        printf("  pool cached %7.1f MB", stats.cachedBytes / 1048576.0);
+    }
+    printf("\n");
+}
+
+static void runMode(bool pool, int numThreads, int numConns, int numOps)
+{
+    const char *mode = pool ? "pool" : "malloc";
+    Alloc alloc(pool);
+    std::vector<Worker> workers(numThreads);
+    std::vector<Handoff> handoffs(numThreads);
+    for (Worker &w : workers)
+    {
+        w.conns.resize(numConns, Conn{Slot{nullptr, 0, 0, 0}, Slot{nullptr, 0, 0, 0}});
+    }
+
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            runChurn(alloc, workers[i], handoffs[i], handoffs[(i + 1) % numThreads], numOps, i + 1);
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        drainHandoff(alloc, handoffs[i]);
+    }
+
+    int64_t ops = 0;
+    for (const Worker &w : workers)
+    {
+        ops += w.ops;
+    }
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    printf("%-6s %.2fs  %.0f ops/s  peak rss %.1f MB\n", mode, seconds, ops / seconds, usage.ru_maxrss / 1024.0);
+    report(mode, "after churn", workers);
+
+    threads.clear();
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            closeMost(alloc, workers[i], handoffs[i], handoffs[(i + 1) % numThreads], 100 + i);
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        drainHandoff(alloc, handoffs[i]);
+    }
+    report(mode, "90% closed", workers);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int numConns = argc > 2 ? atoi(argv[2]) : 2000;
+    int numOps = argc > 3 ? atoi(argv[3]) : 1000000;
+    printf("threads %d  conns/thread %d  ops/thread %d\n", numThreads, numConns, numOps);
+    fflush(stdout);
+
+    const bool modes[] = {true, false};
+    for (bool pool : modes)
+    {
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            runMode(pool, numThreads, numConns, numOps);
+            _exit(0);
+        }
+        ::waitpid(pid, nullptr, 0);
+    }
+    return 0;
+}
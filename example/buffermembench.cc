@@ -0,0 +1,172 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoopThreadPool.h>
+#include <mymuduo/ChunkPool.h>
+#include <mymuduo/BufferAllocator.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 连接缓冲区内存占用：按阶段打印每个subLoop的缓冲区内存
+// 1. 建立N个连接，不收发数据           => 缓冲区按需分配，应该为0
+// 2. 每个连接echo一条小消息           => inputBuffer分配了内存
+// 3. 一个连接上传一条大消息，一个连接请求一条大响应，客户端暂时不读 => 峰值
+// 4. 大消息处理完、大响应被读完       => 超过阈值的inputBuffer和发送缓冲区的块马上释放
+// 5. 等待超过缓冲区空闲时间           => 小连接的inputBuffer也被释放
+// 用法：./buffermembench [连接数] [大消息字节数]
+
+static const uint16_t kPort = 9983;
+
+static void printStats(TcpServer &server, const char *phase)
+{
+    printf("%s\n", phase);
+    std::vector<EventLoop *> loops = server.threadPool()->getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        const std::shared_ptr<ChunkPool> &pool = loops[i]->chunkPool();
+        printf("    loop %zu: inputBuffer %8.1f KB  output chunks in use %8.1f KB\n", i,
+               loops[i]->inputBufferBytes() / 1024.0, pool->inUseBytes() / 1024.0);
+    }
+    BufferAllocator::Stats stats = BufferAllocator::stats();
+    printf("    allocator: reserved %8.1f KB  cached %8.1f KB\n", stats.reservedBytes / 1024.0, stats.cachedBytes / 1024.0);
+    fflush(stdout);
+}
+
+static int connectServer()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return sockfd;
+}
+
+static void sendAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::send(fd, data, len, 0);
+        if (n <= 0)
+        {
+            perror("send");
+            exit(1);
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void recvAll(int fd, size_t len)
+{
+    char buf[65536];
+    while (len > 0)
+    {
+        ssize_t n = ::recv(fd, buf, std::min(len, sizeof buf), 0);
+        if (n <= 0)
+        {
+            perror("recv");
+            exit(1);
+        }
+        len -= n;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    int numConns = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t bigSize = argc > 2 ? atoi(argv[2]) : 16 * 1024 * 1024;
+    const size_t kSmallSize = 100;
+    const double kIdleSeconds = 1.0;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "buffermembench");
+    server.setThreadNum(2);
+    server.setBufferShrink(kIdleSeconds, TcpConnection::kDefaultBufferShrinkThreshold);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    // 1字节的请求回复一条大响应；小消息原样返回；大消息收齐之后才处理
+    std::string bigResponse(bigSize, 'r');
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        size_t n = buf->readableBytes();
+        if (n == 1)
+        {
+            buf->retrieveAll();
+            conn->send(bigResponse);
+        }
+        else if (n <= kSmallSize)
+        {
+            conn->send(buf->retreiveAllAsString());
+        }
+        else if (n >= bigSize)
+        {
+            buf->retrieveAll();
+            conn->send(std::string(1, 'u'));
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < numConns; ++i)
+        {
+            fds.push_back(connectServer());
+        }
+        ::usleep(200 * 1000);
+        printStats(server, "1. connected, no traffic");
+
+        std::string small(kSmallSize, 's');
+        for (int fd : fds)
+        {
+            sendAll(fd, small.data(), small.size());
+        }
+        for (int fd : fds)
+        {
+            recvAll(fd, small.size());
+        }
+        ::usleep(200 * 1000);
+        printStats(server, "2. one small echo per connection");
+
+        // fds[0]请求大响应但先不读，fds[1]上传大消息
+        sendAll(fds[0], "R", 1);
+        std::string bigRequest(bigSize, 'u');
+        sendAll(fds[1], bigRequest.data(), bigRequest.size() - 1);
+        ::usleep(200 * 1000);
+        printStats(server, "3. big upload in progress, big response not read yet");
+
+        sendAll(fds[1], bigRequest.data(), 1);
+        recvAll(fds[1], 1);
+        recvAll(fds[0], bigSize);
+        ::usleep(200 * 1000);
+        printStats(server, "4. big messages done");
+
+        ::usleep(static_cast<useconds_t>((kIdleSeconds * 2 + 0.5) * 1000 * 1000));
+        printStats(server, "5. after buffer idle period");
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        // 等服务端处理完断开，避免连接销毁的任务留在mainLoop的队列里
+        ::usleep(200 * 1000);
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
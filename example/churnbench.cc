@@ -0,0 +1,143 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 连接抖动压测：Poller的channel表在频繁注册/删除时的开销
+// 1. 注册抖动：已有一批常驻channel的情况下，反复 创建fd -> enableReading -> disableAll -> remove -> close
+//    fd会被立即复用，和短连接服务器的情况一样
+// 2. accept/close风暴：客户端不停地connect再close，服务端接受连接再关闭
+// 用法：./churnbench [常驻channel数] [注册抖动次数] [短连接数]
+
+// 统计operator new的调用次数
+static std::atomic<int64_t> g_numAllocs(0);
+
+void *operator new(size_t size)
+{
+    g_numAllocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+static void registrationChurn(int numResident, int iterations)
+{
+    EventLoop loop;
+
+    // 常驻的channel，让表里一直有足够多的fd
+    std::vector<int> fds;
+    std::vector<Channel *> resident;
+    for (int i = 0; i < numResident; ++i)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Channel *channel = new Channel(&loop, fd);
+        channel->enableReading();
+        fds.push_back(fd);
+        resident.push_back(channel);
+    }
+
+    int64_t allocs = g_numAllocs.load();
+    int64_t found = 0;
+    Timestamp start(Timestamp::monotonicNow());
+    for (int i = 0; i < iterations; ++i)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Channel channel(&loop, fd);
+        channel.enableReading();
+        channel.enableWriting();
+        found += loop.hasChannel(&channel);
+        channel.disableAll();
+        channel.remove();
+        ::close(fd);
+    }
+    double seconds = timeDifference(Timestamp::monotonicNow(), start);
+    allocs = g_numAllocs.load() - allocs;
+
+    printf("registration churn: %d resident channels, %d iterations, %.3f s, %.0f ns/iteration, %.3f allocs/iteration (found %lld)\n",
+           numResident, iterations, seconds, seconds * 1e9 / iterations,
+           static_cast<double>(allocs) / iterations, static_cast<long long>(found));
+
+    for (size_t i = 0; i < resident.size(); ++i)
+    {
+        resident[i]->disableAll();
+        resident[i]->remove();
+        delete resident[i];
+        ::close(fds[i]);
+    }
+}
+
+static void acceptCloseStorm(int numConns)
+{
+    const uint16_t port = 9982;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "churnbench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    std::thread client([&]() {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+        int64_t allocs = g_numAllocs.load();
+        Timestamp start(Timestamp::monotonicNow());
+        for (int i = 0; i < numConns; ++i)
+        {
+            int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+            {
+                perror("connect");
+                exit(1);
+            }
+            ::close(sockfd);
+        }
+        double seconds = timeDifference(Timestamp::monotonicNow(), start);
+        allocs = g_numAllocs.load() - allocs;
+
+        printf("accept/close storm: %d connections, %.3f s, %.0f conn/s, %.1f allocs/connection\n",
+               numConns, seconds, numConns / seconds, static_cast<double>(allocs) / numConns);
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    int numResident = argc > 1 ? atoi(argv[1]) : 1000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+    int numConns = argc > 3 ? atoi(argv[3]) : 10000;
+
+    registrationChurn(numResident, iterations);
+    acceptCloseStorm(numConns);
+    return 0;
+}
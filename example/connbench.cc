@@ -0,0 +1,143 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 建连速率：客户端线程不停地connect再用RST关闭（SO_LINGER 0，不留TIME_WAIT），服务端接受连接、建立、销毁
+// 统计端到端的conn/s、acceptor loop（mainLoop线程）每个连接花的CPU时间，以及每个连接的operator new次数
+// 服务端监听127.0.0.1（具体的IP），新连接的本端地址直接取监听地址
+// 结束后用TcpServer::forEachConnection确认各个subLoop的连接表都已清空
+// 用法：./connbench [连接数] [客户端线程数] [subLoop数]
+
+static const uint16_t kPort = 9991;
+
+static std::atomic<int64_t> g_numAllocs(0);
+
+void *operator new(size_t size)
+{
+    g_numAllocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+static double threadCpuSeconds(pthread_t thread)
+{
+    clockid_t cid;
+    pthread_getcpuclockid(thread, &cid);
+    struct timespec ts;
+    ::clock_gettime(cid, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void connectLoop(int count)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    struct linger lin = {1, 0};
+    for (int i = 0; i < count; ++i)
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        ::setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+        ::close(sockfd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(FATAL); // RST关闭的连接会报ECONNRESET，不打印
+    int numConns = argc > 1 ? atoi(argv[1]) : 20000;
+    int numClients = argc > 2 ? atoi(argv[2]) : 2;
+    int numLoops = argc > 3 ? atoi(argv[3]) : 1;
+
+    std::atomic<int> established(0);
+    std::atomic<int> destroyed(0);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort, "127.0.0.1"), "connbench");
+    server.setThreadNum(numLoops);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            established.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            destroyed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+    pthread_t acceptorThread = pthread_self();
+
+    std::thread client([&]() {
+        int64_t allocs = g_numAllocs.load();
+        double cpuStart = threadCpuSeconds(acceptorThread);
+        Timestamp start(Timestamp::monotonicNow());
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numClients; ++i)
+        {
+            threads.emplace_back(connectLoop, numConns / numClients);
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        const int total = numConns / numClients * numClients;
+        while (destroyed.load() < total)
+        {
+            ::usleep(1000);
+        }
+        double seconds = timeDifference(Timestamp::monotonicNow(), start);
+        double cpu = threadCpuSeconds(acceptorThread) - cpuStart;
+        allocs = g_numAllocs.load() - allocs;
+
+        std::atomic<int> live(0);
+        std::atomic<bool> visited(false);
+        server.forEachConnection([&](const TcpConnectionPtr &) { live.fetch_add(1); },
+                                 [&]() { visited = true; });
+        while (!visited.load())
+        {
+            ::usleep(1000);
+        }
+
+        printf("%d connections, %d clients, %d subLoops: %.3f s, %.0f conn/s, acceptor loop %.2f us/conn, "
+               "%.1f allocs/conn, %d live%s\n",
+               total, numClients, numLoops, seconds, total / seconds, cpu * 1e6 / total,
+               static_cast<double>(allocs) / total, live.load(), established.load() == total ? "" : "  ESTABLISHED MISMATCH");
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * 流水线请求-应答压测，比较普通模式和攒包模式（TcpServer::setCorked）
+ * 每个客户端连接一次发送depth个请求，服务端对每个请求send两次（头部 + 正文），客户端收齐depth个应答后再发下一批
+ * 两种模式都设置TCP_NODELAY，否则普通模式的第二次小块写会被Nagle算法扣住，等对端的延迟ACK（约40ms）
+ * 拦截libc的write/writev统计服务端每个请求的发送系统调用次数（客户端用send/recv，不会被统计）
+ * 客户端统计每一批的往返时延，输出p50/p99
+ * 用法：./corkbench [连接数] [流水线深度] [每个连接的批数]
+ */
+
+static const uint16_t kPort = 9990;
+static const size_t kRequestSize = 16;
+static const char kHeader[] = "HDR 0000000112\r\n";
+static const size_t kBodySize = 112;
+static const size_t kResponseSize = sizeof kHeader - 1 + kBodySize;
+
+static std::atomic<int64_t> g_writes(0);
+
+template <typename Fn>
+static Fn realFunc(const char *name)
+{
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C"
+{
+    ssize_t write(int fd, const void *buf, size_t count)
+    {
+        static auto real = realFunc<ssize_t (*)(int, const void *, size_t)>("write");
+        g_writes.fetch_add(1, std::memory_order_relaxed);
+        return real(fd, buf, count);
+    }
+
+    ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+    {
+        static auto real = realFunc<ssize_t (*)(int, const struct iovec *, int)>("writev");
+        g_writes.fetch_add(1, std::memory_order_relaxed);
+        return real(fd, iov, iovcnt);
+    }
+}
+
+static int connectServer()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return sockfd;
+}
+
+// 返回每一批的往返时延（微秒），数据不对时置*ok为false
+static std::vector<int64_t> clientFunc(int depth, int batches, bool *ok)
+{
+    int sockfd = connectServer();
+    std::string requests(kRequestSize * depth, 'q');
+    std::vector<char> buf(kResponseSize * depth);
+    std::vector<int64_t> latencies;
+    latencies.reserve(batches);
+    for (int b = 0; b < batches; ++b)
+    {
+        Timestamp start(Timestamp::now());
+        if (::send(sockfd, requests.data(), requests.size(), 0) != static_cast<ssize_t>(requests.size()))
+        {
+            perror("send");
+            exit(1);
+        }
+        for (size_t received = 0; received < buf.size();)
+        {
+            ssize_t n = ::recv(sockfd, buf.data() + received, buf.size() - received, 0);
+            if (n <= 0)
+            {
+                perror("recv");
+                exit(1);
+            }
+            received += n;
+        }
+        latencies.push_back(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+        for (int i = 0; i < depth; ++i)
+        {
+            const char *response = buf.data() + i * kResponseSize;
+            if (memcmp(response, kHeader, sizeof kHeader - 1) != 0 || response[kResponseSize - 1] != 'b')
+            {
+                *ok = false;
+            }
+        }
+    }
+    ::close(sockfd);
+    return latencies;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    int conns = argc > 1 ? atoi(argv[1]) : 4;
+    int depth = argc > 2 ? atoi(argv[2]) : 16;
+    int batches = argc > 3 ? atoi(argv[3]) : 2000;
+    const std::string body(kBodySize, 'b');
+
+    // 攒包模式在连接建立的回调里设置，这时已经在subLoop中
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "corkbench");
+    server.setThreadNum(1);
+    std::atomic<bool> corked(false);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->setCorked(corked);
+        }
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        while (buf->readableBytes() >= kRequestSize)
+        {
+            buf->retrieve(kRequestSize);
+            conn->send(kHeader, sizeof kHeader - 1);
+            conn->send(body.data(), body.size());
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        const char *names[] = {"plain", "corked"};
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            corked = (mode == 1);
+            std::mutex mutex;
+            std::vector<int64_t> latencies;
+            bool ok = true;
+            int64_t writesStart = g_writes.load();
+            Timestamp start(Timestamp::now());
+            std::vector<std::thread> threads;
+            for (int i = 0; i < conns; ++i)
+            {
+                threads.emplace_back([&]() {
+                    bool connOk = true;
+                    std::vector<int64_t> result(clientFunc(depth, batches, &connOk));
+                    std::lock_guard<std::mutex> lock(mutex);
+                    latencies.insert(latencies.end(), result.begin(), result.end());
+                    ok = ok && connOk;
+                });
+            }
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+            double requests = static_cast<double>(conns) * depth * batches;
+            std::sort(latencies.begin(), latencies.end());
+            printf("%-6s %d conns x depth %d x %d batches: %.0f req/s, write syscalls/req %.3f, "
+                   "batch latency p50 %lld us p99 %lld us%s\n",
+                   names[mode], conns, depth, batches, requests / seconds, (g_writes.load() - writesStart) / requests,
+                   static_cast<long long>(latencies[latencies.size() / 2]),
+                   static_cast<long long>(latencies[latencies.size() * 99 / 100]), ok ? "" : "  VERIFY FAILED");
+            fflush(stdout);
+            ::usleep(100 * 1000);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * echo压测，比较LT和ET模式下服务端的系统调用次数
+ * 在可执行文件里定义同名函数拦截libc的epoll_wait/epoll_ctl/readv/write/syscall(io_uring_enter)，统计服务端的调用次数
+ * 客户端用send/recv，不会被统计
+ * 用法：./echobench [lt|et] [连接数] [消息大小] [每个连接的往返次数]，不指定模式时两种都跑
+ * MUDUO_USE_IO_URING=1 ./echobench 使用IoUringPoller
+ */
+
+static std::atomic<int64_t> g_epollWait(0);
+static std::atomic<int64_t> g_epollCtl(0);
+static std::atomic<int64_t> g_readv(0);
+static std::atomic<int64_t> g_write(0);
+static std::atomic<int64_t> g_uringEnter(0);
+
+template <typename Fn>
+static Fn realFunc(const char *name)
+{
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C"
+{
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+    {
+        static auto real = realFunc<int (*)(int, struct epoll_event *, int, int)>("epoll_wait");
+        g_epollWait.fetch_add(1, std::memory_order_relaxed);
+        return real(epfd, events, maxevents, timeout);
+    }
+
+    int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) noexcept
+    {
+        static auto real = realFunc<int (*)(int, int, int, struct epoll_event *)>("epoll_ctl");
+        g_epollCtl.fetch_add(1, std::memory_order_relaxed);
+        return real(epfd, op, fd, event);
+    }
+
+    ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+    {
+        static auto real = realFunc<ssize_t (*)(int, const struct iovec *, int)>("readv");
+        g_readv.fetch_add(1, std::memory_order_relaxed);
+        return real(fd, iov, iovcnt);
+    }
+
+    ssize_t write(int fd, const void *buf, size_t count)
+    {
+        static auto real = realFunc<ssize_t (*)(int, const void *, size_t)>("write");
+        g_write.fetch_add(1, std::memory_order_relaxed);
+        return real(fd, buf, count);
+    }
+
+    // x86-64上系统调用最多6个参数，全部原样转发
+    long syscall(long number, ...) noexcept
+    {
+        static auto real = realFunc<long (*)(long, ...)>("syscall");
+        va_list ap;
+        va_start(ap, number);
+        long a1 = va_arg(ap, long), a2 = va_arg(ap, long), a3 = va_arg(ap, long);
+        long a4 = va_arg(ap, long), a5 = va_arg(ap, long), a6 = va_arg(ap, long);
+        va_end(ap);
+        if (number == __NR_io_uring_enter)
+        {
+            g_uringEnter.fetch_add(1, std::memory_order_relaxed);
+        }
+        return real(number, a1, a2, a3, a4, a5, a6);
+    }
+}
+
+static void clientFunc(uint16_t port, int msgSize, int rounds)
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+
+    std::string msg(msgSize, 'x');
+    std::vector<char> buf(msgSize);
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (size_t sent = 0; sent < msg.size();)
+        {
+            ssize_t n = ::send(sockfd, msg.data() + sent, msg.size() - sent, 0);
+            if (n <= 0)
+            {
+                perror("send");
+                exit(1);
+            }
+            sent += n;
+        }
+        for (size_t received = 0; received < buf.size();)
+        {
+            ssize_t n = ::recv(sockfd, buf.data() + received, buf.size() - received, 0);
+            if (n <= 0)
+            {
+                perror("recv");
+                exit(1);
+            }
+            received += n;
+        }
+    }
+    ::close(sockfd);
+}
+
+static void runOnce(bool edgeTriggered, int numConns, int msgSize, int rounds)
+{
+    Logger::setLogLevel(ERROR);
+    const uint16_t port = 9981;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "echobench");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retreiveAllAsString());
+    });
+    server.start();
+
+    std::thread clients([&]() {
+        g_epollWait = g_epollCtl = g_readv = g_write = g_uringEnter = 0;
+        Timestamp start(Timestamp::monotonicNow());
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numConns; ++i)
+        {
+            threads.emplace_back(clientFunc, port, msgSize, rounds);
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+
+        double seconds = timeDifference(Timestamp::monotonicNow(), start);
+        double trips = static_cast<double>(numConns) * rounds;
+        printf("%s %s: %d conns x %d rounds x %d bytes, %.3f s, %.0f round trips/s\n",
+               getenv("MUDUO_USE_IO_URING") ? "io_uring" : "epoll", edgeTriggered ? "ET" : "LT", numConns, rounds, msgSize, seconds, trips / seconds);
+        printf("    per round trip: epoll_wait %.2f  epoll_ctl %.2f  io_uring_enter %.2f  readv %.2f  write %.2f\n",
+               g_epollWait / trips, g_epollCtl / trips, g_uringEnter / trips, g_readv / trips, g_write / trips);
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    clients.join();
+}
+
+int main(int argc, char *argv[])
+{
+    int numConns = argc > 2 ? atoi(argv[2]) : 4;
+    int msgSize = argc > 3 ? atoi(argv[3]) : 256 * 1024;
+    int rounds = argc > 4 ? atoi(argv[4]) : 200;
+
+    if (argc > 1 && strcmp(argv[1], "lt") == 0)
+    {
+        runOnce(false, numConns, msgSize, rounds);
+    }
+    else if (argc > 1 && strcmp(argv[1], "et") == 0)
+    {
+        runOnce(true, numConns, msgSize, rounds);
+    }
+    else
+    {
+        // 两种模式各用一个子进程，互不影响
+        bool modes[] = {false, true};
+        for (bool et : modes)
+        {
+            pid_t pid = ::fork();
+            if (pid == 0)
+            {
+                runOnce(et, numConns, msgSize, rounds);
+                _exit(0);
+            }
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                fprintf(stderr, "%s child exited abnormally, status %d\n", et ? "ET" : "LT", status);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <mymuduo/Logger.h>
+#include <mymuduo/AsyncLogging.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// 日志压测：比较同步输出（stdout重定向到文件）和AsyncLogging的每秒行数
+// sync+flush 每行都fflush，相当于原来的 std::cout << ... << std::endl
+// 用法：./logbench [线程数] [每个线程的行数]
+
+AsyncLogging *g_asyncLog = nullptr;
+
+void asyncOutput(const char *msg, int len)
+{
+    g_asyncLog->append(msg, len);
+}
+
+void flushOutput(const char *msg, int len)
+{
+    fwrite(msg, 1, len, stdout);
+    fflush(stdout);
+}
+
+double run(int numThreads, int numLines)
+{
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([numLines]() {
+            for (int i = 0; i < numLines; ++i)
+            {
+                LOG_INFO("logbench line %d abcdefghijklmnopqrstuvwxyz 0123456789", i);
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    return static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch())
+           / Timestamp::kMicroSecondsPerSecond;
+}
+
+int main(int argc, char *argv[])
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int numLines = argc > 2 ? atoi(argv[2]) : 250000;
+    int total = numThreads * numLines;
+
+    // 同步：默认输出到stdout，这里重定向到文件
+    if (freopen("/tmp/logbench_sync.log", "w", stdout) == nullptr)
+    {
+        perror("freopen");
+        return 1;
+    }
+    Logger::instance().setOutput(flushOutput);
+    double flushSec = run(numThreads, numLines);
+    fprintf(stderr, "sync+flush : %d lines %.3f s %.0f lines/s\n", total, flushSec, total / flushSec);
+
+    Logger::instance().setOutput(
+        [](const char *msg, int len) { fwrite(msg, 1, len, stdout); });
+    double syncSec = run(numThreads, numLines);
+    fflush(stdout);
+    fprintf(stderr, "sync       : %d lines %.3f s %.0f lines/s\n", total, syncSec, total / syncSec);
+
+    // 运行期过滤：阈值设为ERROR，LOG_INFO不会格式化
+    Logger::setLogLevel(ERROR);
+    double filteredSec = run(numThreads, numLines);
+    fprintf(stderr, "filtered   : %d lines %.3f s %.1f ns/line\n", total, filteredSec, filteredSec * 1e9 / total);
+    Logger::setLogLevel(INFO);
+
+    // 异步
+    AsyncLogging async("/tmp/logbench_async", 500 * 1024 * 1024);
+    g_asyncLog = &async;
+    async.start();
+    Logger::instance().setOutput(asyncOutput);
+    double asyncSec = run(numThreads, numLines);
+    fprintf(stderr, "async      : %d lines %.3f s %.0f lines/s (dropped buffers %ld)\n",
+            total, asyncSec, total / asyncSec, (long)async.droppedBuffers());
+    async.stop();
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// 跨线程投递压测：N个生产者线程同时向同一个loop queueInLoop
+// 投递的任务和TcpConnection里的用法一样：std::bind一个成员函数 + shared_ptr + 两个参数
+// 用法：./queuebench [每个线程投递的任务数]
+
+// 统计operator new的调用次数，用来计算每次投递的内存分配次数
+static std::atomic<int64_t> g_numAllocs(0);
+
+void *operator new(size_t size)
+{
+    g_numAllocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+struct Sink
+{
+    Sink() : executed(0), bytes(0) {}
+
+    // 只在loop线程里修改
+    void consume(const void *data, size_t len)
+    {
+        ++executed;
+        bytes += len;
+    }
+
+    int64_t executed;
+    int64_t bytes;
+};
+
+static void runOnce(EventLoop *loop, int numProducers, int numTasks)
+{
+    std::shared_ptr<Sink> sink(new Sink);
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool finished = false;
+
+    int64_t allocs = g_numAllocs.load();
+    int64_t written = loop->wakeupsWritten();
+    int64_t saved = loop->wakeupsSaved();
+    Timestamp start(Timestamp::monotonicNow());
+    std::vector<std::thread> producers;
+    for (int p = 0; p < numProducers; ++p)
+    {
+        producers.emplace_back([=]() {
+            for (int i = 0; i < numTasks; ++i)
+            {
+                loop->queueInLoop(std::bind(&Sink::consume, sink, static_cast<const void *>(nullptr), static_cast<size_t>(i)));
+            }
+        });
+    }
+    for (std::thread &t : producers)
+    {
+        t.join();
+    }
+    double postSec = timeDifference(Timestamp::monotonicNow(), start);
+    // 生产者线程的创建也会分配内存，只占很小的一部分
+    double allocsPerPost = static_cast<double>(g_numAllocs.load() - allocs) / (static_cast<int64_t>(numProducers) * numTasks);
+
+    // 最后一个任务执行时，前面投递的任务都已经执行完了
+    loop->queueInLoop([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished = true;
+        cond.notify_one();
+    });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!finished)
+        {
+            cond.wait(lock);
+        }
+    }
+    double totalSec = timeDifference(Timestamp::monotonicNow(), start);
+
+    int64_t total = static_cast<int64_t>(numProducers) * numTasks;
+    printf("producers %2d: %ld tasks, post %.3f s (%.0f posts/s), drained %.3f s (%.0f tasks/s), executed %ld\n",
+           numProducers, (long)total, postSec, total / postSec, totalSec, total / totalSec, (long)sink->executed);
+    printf("              allocations per post %.2f, eventfd writes %ld, wakeups saved %ld\n", allocsPerPost,
+           (long)(loop->wakeupsWritten() - written), (long)(loop->wakeupsSaved() - saved));
+}
+
+int main(int argc, char *argv[])
+{
+    int numTasks = argc > 1 ? atoi(argv[1]) : 1000000;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    int producers[] = {1, 2, 4, 8};
+    for (int n : producers)
+    {
+        runOnce(loop, n, numTasks / n);
+    }
+    return 0;
+}
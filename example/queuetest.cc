@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <functional>
+
+template <typename T>
+class MpscQueue;
+static void beforeStubPush(MpscQueue<int> *queue);
+#define MPSCQUEUE_BEFORE_STUB_PUSH(queue) beforeStubPush(queue)
+
+#include <mymuduo/MpscQueue.h>
+
+// MpscQueue::consume的边界检查：在pop把stub放回队尾之前插入生产者的push（多线程下是一个很小的时间窗口）
+// 插进来的元素排在stub前面，队尾变成stub，下一次consume必须执行到它，否则它会一直留在队列里，
+// 直到有不相关的投递才被执行（EventLoop里就是丢了一次wakeup）
+// 用法：./queuetest
+
+static std::function<void(MpscQueue<int> *)> g_hook;
+
+static void beforeStubPush(MpscQueue<int> *queue)
+{
+    if (g_hook)
+    {
+        std::function<void(MpscQueue<int> *)> hook;
+        hook.swap(g_hook); // 只插入一次
+        hook(queue);
+    }
+}
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+int main()
+{
+    MpscQueue<int> queue;
+    int sum = 0;
+    auto add = [&](int &v) { sum += v; };
+
+    // 1. 插入一个元素
+    queue.push(1);
+    g_hook = [](MpscQueue<int> *q) { q->push(42); };
+    size_t n = queue.consume(add);
+    check(n == 1 && sum == 1, "first consume stops at the element it saw");
+    sum = 0;
+    n = queue.consume(add);
+    check(n == 1 && sum == 42, "element pushed before the stub is consumed next time");
+    check(queue.consume(add) == 0, "queue is empty afterwards");
+
+    // 2. 插入多个元素
+    sum = 0;
+    queue.push(1);
+    g_hook = [](MpscQueue<int> *q) {
+        q->push(10);
+        q->push(100);
+    };
+    queue.consume(add);
+    sum = 0;
+    n = queue.consume(add);
+    check(n == 2 && sum == 110, "all elements pushed before the stub are consumed next time");
+
+    // 3. stub在队尾，后面又有新的push：本次只执行stub之前的，新的留到下一次
+    sum = 0;
+    queue.push(1);
+    g_hook = [](MpscQueue<int> *q) { q->push(2); };
+    queue.consume(add);
+    sum = 0;
+    bool pushed = false;
+    n = queue.consume([&](int &v) {
+        sum += v;
+        if (!pushed)
+        {
+            pushed = true;
+            queue.push(1000); // 执行过程中新入队的
+        }
+    });
+    check(n == 1 && sum == 2, "elements pushed during consume are left for the next one");
+    sum = 0;
+    n = queue.consume(add);
+    check(n == 1 && sum == 1000, "which then consumes them");
+    check(queue.consume(add) == 0 && queue.pop() == nullptr, "queue is empty at the end");
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    return 0;
+}
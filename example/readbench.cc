@@ -0,0 +1,131 @@
+#include <mymuduo/Buffer.h>
+#include <mymuduo/AdaptiveRecvSize.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// 读路径微基准：socketpair的一端写入一条消息，另一端读进Buffer，反复N次
+// legacy   : 原来的实现，每次读都在栈上清零64KB的extrabuf
+// arena    : 使用不清零的接收区（和EventLoop::recvArena一样）
+// adaptive : 接收区 + AdaptiveRecvSize，读之前按预测值扩充Buffer，大消息直接落在Buffer里
+// 用法：./readbench [次数]
+
+static const size_t kArenaSize = 64 * 1024;
+
+// 原来的Buffer::readFd
+static ssize_t legacyReadFd(Buffer *buf, int fd, int *savedErrno)
+{
+    char extrabuf[65536] = {0};
+
+    struct iovec vec[2];
+    const size_t writable = buf->writableBytes();
+    vec[0].iov_base = buf->beginWrite();
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    const int iovcnt = (writable < sizeof extrabuf ? 2 : 1);
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else if (static_cast<size_t>(n) <= writable)
+    {
+        buf->hasWritten(n);
+    }
+    else
+    {
+        buf->hasWritten(writable);
+        buf->append(extrabuf, n - writable);
+    }
+    return n;
+}
+
+enum Mode
+{
+    kLegacy,
+    kArena,
+    kAdaptive
+};
+
+static void runOnce(Mode mode, size_t msgSize, int iterations)
+{
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+        perror("socketpair");
+        exit(1);
+    }
+    int sndbuf = 4 * 1024 * 1024;
+    ::setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+
+    std::string msg(msgSize, 'x');
+    std::vector<char> arena(kArenaSize);
+    AdaptiveRecvSize recvSize;
+    Buffer buf;
+
+    int64_t bytes = 0;
+    Timestamp start(Timestamp::monotonicNow());
+    for (int i = 0; i < iterations; ++i)
+    {
+        if (::write(sv[0], msg.data(), msg.size()) != static_cast<ssize_t>(msg.size()))
+        {
+            perror("write");
+            exit(1);
+        }
+        for (size_t received = 0; received < msgSize;)
+        {
+            int err = 0;
+            ssize_t n = 0;
+            switch (mode)
+            {
+            case kLegacy:
+                n = legacyReadFd(&buf, sv[1], &err);
+                break;
+            case kArena:
+                n = buf.readFd(sv[1], &err, arena.data(), arena.size());
+                break;
+            case kAdaptive:
+                n = buf.readFd(sv[1], &err, arena.data(), arena.size(), &recvSize);
+                break;
+            }
+            if (n <= 0)
+            {
+                perror("read");
+                exit(1);
+            }
+            received += n;
+        }
+        bytes += msgSize;
+        buf.retrieveAll();
+    }
+    double seconds = timeDifference(Timestamp::monotonicNow(), start);
+
+    const char *names[] = {"legacy", "arena", "adaptive"};
+    printf("%-8s %6zu bytes/msg: %.0f ns/msg, %.0f MB/s\n",
+           names[mode], msgSize, seconds * 1e9 / iterations, bytes / seconds / 1024 / 1024);
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t sizes[] = {64, 512, 4096, 32768};
+    for (size_t size : sizes)
+    {
+        runOnce(kLegacy, size, iterations);
+        runOnce(kArena, size, iterations);
+        runOnce(kAdaptive, size, iterations);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoopThreadPool.h>
+#include <mymuduo/ChunkPool.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// TCP中继吞吐：客户端先后建立两个连接，中继把它们配对，第一个连接上发送的数据转发到第二个连接
+// 中继配对后给第二个连接发送1字节，客户端收到后开始发送；发送方发完N MB后关闭连接，接收方一直读到EOF，校验字节数和内容
+// copy   : onMessage里把inputBuffer的数据send给对端，数据经过inputBuffer、outputBuffer
+// splice : TcpConnection::forwardTo，socket => pipe => socket
+// 每种模式跑两次：一次统计吞吐和CPU时间，一次让接收方先暂停，看中继在发送缓冲区里积压了多少数据
+// 用法：./relaybench [MB]
+
+static const uint16_t kPort = 9985;
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int connectRelay()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return sockfd;
+}
+
+static char patternByte(size_t offset)
+{
+    return static_cast<char>(offset * 7 + offset / 65536);
+}
+
+static void writeAll(int fd, size_t total)
+{
+    char buf[65536];
+    size_t sent = 0;
+    while (sent < total)
+    {
+        size_t len = std::min(sizeof buf, total - sent);
+        for (size_t i = 0; i < len; ++i)
+        {
+            buf[i] = patternByte(sent + i);
+        }
+        size_t off = 0;
+        while (off < len)
+        {
+            ssize_t n = ::send(fd, buf + off, len - off, 0);
+            if (n <= 0)
+            {
+                perror("send");
+                exit(1);
+            }
+            off += n;
+        }
+        sent += len;
+    }
+}
+
+// 读到EOF，返回是否校验通过
+static bool readAll(int fd, size_t total)
+{
+    char buf[65536];
+    size_t received = 0;
+    bool ok = true;
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof buf, 0)) > 0)
+    {
+        for (ssize_t i = 0; i < n; i += 61)
+        {
+            if (buf[i] != patternByte(received + i))
+            {
+                ok = false;
+            }
+        }
+        received += n;
+    }
+    return ok && received == total;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    size_t total = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 256) * 1024 * 1024;
+
+    std::atomic<bool> useSplice(false);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "relaybench");
+    server.setThreadNum(1);
+    // 以下只在subLoop中访问
+    TcpConnectionPtr waiting;
+    std::map<std::string, std::weak_ptr<TcpConnection>> peers;
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            // copy模式下自己把关闭传给对端；splice模式下由forwardTo处理
+            auto it = peers.find(conn->getName());
+            if (it != peers.end())
+            {
+                TcpConnectionPtr peer(it->second.lock());
+                if (peer)
+                {
+                    peer->shutdown();
+                }
+                peers.erase(it);
+            }
+            return;
+        }
+        if (!waiting)
+        {
+            waiting = conn;
+            return;
+        }
+        // 配对完成后通知客户端开始发送
+        conn->send("R");
+        if (useSplice)
+        {
+            waiting->forwardTo(conn);
+            conn->forwardTo(waiting);
+        }
+        else
+        {
+            peers[waiting->getName()] = conn;
+            peers[conn->getName()] = waiting;
+        }
+        waiting.reset();
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        auto it = peers.find(conn->getName());
+        TcpConnectionPtr peer(it == peers.end() ? TcpConnectionPtr() : it->second.lock());
+        if (peer)
+        {
+            peer->send(buf->peek(), buf->readableBytes());
+        }
+        buf->retrieveAll();
+    });
+    server.start();
+    EventLoop *ioLoop = server.threadPool()->getAllLoops()[0];
+
+    std::thread client([&]() {
+        const char *names[] = {"copy", "splice"};
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            useSplice = (mode == 1);
+            for (int paused = 0; paused < 2; ++paused)
+            {
+                int src = connectRelay();
+                int dst = connectRelay();
+                char ready;
+                if (::recv(dst, &ready, 1, 0) != 1)
+                {
+                    perror("recv");
+                    exit(1);
+                }
+                Timestamp start(Timestamp::now());
+                double cpuStart = cpuSeconds();
+                std::thread writer([&]() {
+                    writeAll(src, total);
+                    ::close(src);
+                });
+                double buffered = 0;
+                if (paused)
+                {
+                    ::usleep(500 * 1000);
+                    buffered = ioLoop->chunkPool()->inUseBytes() / 1048576.0;
+                }
+                bool ok = readAll(dst, total);
+                writer.join();
+                ::close(dst);
+                double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+                double cpu = cpuSeconds() - cpuStart;
+                if (paused)
+                {
+                    printf("%-6s reader paused 0.5s: relay output buffered %.1f MB%s\n", names[mode], buffered,
+                           ok ? "" : "  VERIFY FAILED");
+                }
+                else
+                {
+                    printf("%-6s %zu MB: %.2f s, %.0f MB/s, cpu %.2f s%s\n", names[mode], total >> 20, seconds,
+                           (total >> 20) / seconds, cpu, ok ? "" : "  VERIFY FAILED");
+                }
+                fflush(stdout);
+                ::usleep(100 * 1000);
+            }
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
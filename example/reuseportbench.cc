@@ -0,0 +1,175 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 建连速率：比较单Acceptor（mainLoop接受连接再分给subLoop）和kReusePortPerLoop（每个subLoop各自接受）
+// 分别用1、4、16个subLoop，客户端线程不停地connect再用RST关闭（SO_LINGER 0，不留TIME_WAIT）
+// 统计端到端的conn/s、mainLoop线程每个连接花的CPU时间，以及连接在各个loop之间分布的最大/最小值
+// 还有这一轮的accept队列溢出次数（/proc/net/netstat的ListenOverflows），溢出的SYN要等1秒重传，会拉长总时间
+// 用法：./reuseportbench [每轮连接数] [客户端线程数]
+
+static const uint16_t kPort = 9992;
+
+static double threadCpuSeconds(pthread_t thread)
+{
+    clockid_t cid;
+    pthread_getcpuclockid(thread, &cid);
+    struct timespec ts;
+    ::clock_gettime(cid, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// /proc/net/netstat里TcpExt的ListenOverflows，读不到返回-1
+static int64_t listenOverflows()
+{
+    FILE *fp = ::fopen("/proc/net/netstat", "r");
+    if (fp == nullptr)
+    {
+        return -1;
+    }
+    char names[4096];
+    char values[4096];
+    int64_t result = -1;
+    while (result < 0 && ::fgets(names, sizeof names, fp) != nullptr && ::fgets(values, sizeof values, fp) != nullptr)
+    {
+        if (::strncmp(names, "TcpExt:", 7) != 0)
+        {
+            continue;
+        }
+        char *nameSave = nullptr;
+        char *valueSave = nullptr;
+        char *name = ::strtok_r(names, " \n", &nameSave);
+        char *value = ::strtok_r(values, " \n", &valueSave);
+        while (name != nullptr && value != nullptr)
+        {
+            if (::strcmp(name, "ListenOverflows") == 0)
+            {
+                result = ::atoll(value);
+                break;
+            }
+            name = ::strtok_r(nullptr, " \n", &nameSave);
+            value = ::strtok_r(nullptr, " \n", &valueSave);
+        }
+    }
+    ::fclose(fp);
+    return result;
+}
+
+static void connectLoop(int count)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    struct linger lin = {1, 0};
+    for (int i = 0; i < count; ++i)
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        ::setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+        ::close(sockfd);
+    }
+}
+
+static void runOnce(EventLoop *loop, TcpServer::Option option, int numLoops, int numConns, int numClients)
+{
+    std::atomic<int> destroyed(0);
+    std::mutex mutex;
+    std::unordered_map<EventLoop *, int> perLoop;
+
+    TcpServer server(loop, InetAddress(kPort, "127.0.0.1"), "reuseportbench", option);
+    server.setThreadNum(numLoops);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++perLoop[conn->getLoop()];
+        }
+        else
+        {
+            destroyed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+    pthread_t mainThread = pthread_self();
+
+    std::thread client([&]() {
+        double cpuStart = threadCpuSeconds(mainThread);
+        int64_t overflowsStart = listenOverflows();
+        Timestamp start(Timestamp::monotonicNow());
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numClients; ++i)
+        {
+            threads.emplace_back(connectLoop, numConns / numClients);
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        const int total = numConns / numClients * numClients;
+        while (destroyed.load() < total)
+        {
+            ::usleep(1000);
+        }
+        double seconds = timeDifference(Timestamp::monotonicNow(), start);
+        double cpu = threadCpuSeconds(mainThread) - cpuStart;
+        int64_t overflows = listenOverflows() - overflowsStart;
+
+        int maxCount = 0;
+        int minCount = static_cast<int>(perLoop.size()) == numLoops ? total : 0;
+        for (auto &item : perLoop)
+        {
+            maxCount = std::max(maxCount, item.second);
+            minCount = std::min(minCount, item.second);
+        }
+        printf("%-11s %2d subLoops: %d connections, %.3f s, %.0f conn/s, mainLoop %.2f us/conn, per loop %d..%d, "
+               "listen overflows %lld\n",
+               option == TcpServer::kReusePortPerLoop ? "per-loop" : "single", numLoops, total, seconds,
+               total / seconds, cpu * 1e6 / total, minCount, maxCount,
+               static_cast<long long>(overflows));
+        fflush(stdout);
+        // 在loop()之前入队也没关系，loop()开始后第一轮就会执行
+        loop->queueInLoop([loop]() { loop->quit(); });
+    });
+
+    loop->loop();
+    client.join();
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(FATAL); // RST关闭的连接会报ECONNRESET，不打印
+    int numConns = argc > 1 ? atoi(argv[1]) : 20000;
+    int numClients = argc > 2 ? atoi(argv[2]) : 4;
+
+    EventLoop loop;
+    const int loopCounts[] = {1, 4, 16};
+    for (int numLoops : loopCounts)
+    {
+        runOnce(&loop, TcpServer::kNoReusePort, numLoops, numConns, numClients);
+        runOnce(&loop, TcpServer::kReusePortPerLoop, numLoops, numConns, numClients);
+    }
+    return 0;
+}
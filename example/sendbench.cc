@@ -0,0 +1,159 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 工作线程 => loop 的发送吞吐：客户端连上之后，W个工作线程各自生成N条消息，调用conn->send投递到连接所在的loop
+// 客户端读到全部字节为止，统计端到端的消息速率和进程的CPU时间
+// copy   : send(const std::string&)，投递时拷贝一次
+// move   : send(std::string&&)，消息移动进投递的任务
+// buffer : 消息写进Buffer后send(Buffer*)，交换内存
+// raw    : send(const void*, size_t)，从同一块内存拷贝一次（工作线程不需要为每条消息分配）
+// 用法：./sendbench [消息字节] [每个线程的消息数] [线程数]
+
+static const uint16_t kPort = 9988;
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int connectServer()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return sockfd;
+}
+
+static void produce(const TcpConnectionPtr &conn, int mode, size_t msgSize, int count)
+{
+    std::vector<char> raw(msgSize, 'r');
+    Buffer buf;
+    for (int i = 0; i < count; ++i)
+    {
+        switch (mode)
+        {
+        case 0:
+        {
+            std::string msg(msgSize, 'c');
+            conn->send(msg);
+            break;
+        }
+        case 1:
+        {
+            std::string msg(msgSize, 'm');
+            conn->send(std::move(msg));
+            break;
+        }
+        case 2:
+            buf.ensureWritableBytes(msgSize);
+            memset(buf.beginWrite(), 'b', msgSize);
+            buf.hasWritten(msgSize);
+            conn->send(&buf);
+            break;
+        default:
+            conn->send(raw.data(), raw.size());
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    size_t msgSize = argc > 1 ? atoi(argv[1]) : 256;
+    int count = argc > 2 ? atoi(argv[2]) : 100000;
+    int workers = argc > 3 ? atoi(argv[3]) : 4;
+
+    std::mutex mutex;
+    TcpConnectionPtr current;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "sendbench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (conn->connected())
+        {
+            current = conn;
+        }
+        else
+        {
+            current.reset();
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        const char *names[] = {"copy", "move", "buffer", "raw"};
+        const size_t total = msgSize * count * workers;
+        for (int mode = 0; mode < 4; ++mode)
+        {
+            int sockfd = connectServer();
+            TcpConnectionPtr conn;
+            while (!conn)
+            {
+                ::usleep(1000);
+                std::lock_guard<std::mutex> lock(mutex);
+                conn = current;
+            }
+
+            Timestamp start(Timestamp::now());
+            double cpuStart = cpuSeconds();
+            std::vector<std::thread> threads;
+            for (int i = 0; i < workers; ++i)
+            {
+                threads.emplace_back(produce, conn, mode, msgSize, count);
+            }
+            char buf[65536];
+            size_t received = 0;
+            ssize_t n;
+            while (received < total && (n = ::recv(sockfd, buf, sizeof buf, 0)) > 0)
+            {
+                received += n;
+            }
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+            double cpu = cpuSeconds() - cpuStart;
+            printf("%-6s %d x %d x %zu B: %.2f s, %.0f Kmsg/s, %.0f MB/s, cpu %.2f s%s\n", names[mode], workers,
+                   count, msgSize, seconds, count * workers / seconds / 1000, total / seconds / 1048576, cpu,
+                   received == total ? "" : "  VERIFY FAILED");
+            fflush(stdout);
+            conn.reset();
+            ::close(sockfd);
+            ::usleep(100 * 1000);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
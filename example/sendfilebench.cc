@@ -0,0 +1,182 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 大文件下载：客户端连上之后服务端发送 头部 + 文件 + 尾部，发完之后shutdown
+// copy     : 把文件读进std::string再send，数据经过用户态，发送缓冲区里放着整个文件
+// sendfile : TcpConnection::sendFile，数据不经过用户态
+// 客户端校验收到的字节数、头部、尾部和文件内容的采样，统计吞吐和进程的CPU时间
+// 用法：./sendfilebench [文件MB] [次数]
+
+static const uint16_t kPort = 9984;
+static const char kHeader[] = "HEADER\r\n";
+static const char kTrailer[] = "\r\nTRAILER";
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static char fileByte(size_t offset)
+{
+    return static_cast<char>('a' + (offset / 4096) % 26);
+}
+
+static std::string makeFile(size_t size)
+{
+    char path[] = "/tmp/sendfilebenchXXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        exit(1);
+    }
+    std::string block(1024 * 1024, 0);
+    for (size_t offset = 0; offset < size; offset += block.size())
+    {
+        size_t len = std::min(block.size(), size - offset);
+        for (size_t i = 0; i < len; ++i)
+        {
+            block[i] = fileByte(offset + i);
+        }
+        if (::write(fd, block.data(), len) != static_cast<ssize_t>(len))
+        {
+            perror("write");
+            exit(1);
+        }
+    }
+    ::close(fd);
+    return path;
+}
+
+// 接收直到对端关闭，返回是否校验通过
+static bool download(size_t fileSize, size_t *received)
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+
+    const size_t headerLen = sizeof kHeader - 1;
+    const size_t trailerLen = sizeof kTrailer - 1;
+    const size_t total = headerLen + fileSize + trailerLen;
+    std::string head, tail;
+    bool ok = true;
+    size_t pos = 0;
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::recv(sockfd, buf, sizeof buf, 0)) > 0)
+    {
+        for (ssize_t i = 0; i < n; ++i)
+        {
+            size_t at = pos + i;
+            if (at < headerLen)
+            {
+                head += buf[i];
+            }
+            else if (at >= headerLen + fileSize)
+            {
+                tail += buf[i];
+            }
+            else if (at % 997 == 0 && buf[i] != fileByte(at - headerLen))
+            {
+                ok = false;
+            }
+        }
+        pos += n;
+    }
+    ::close(sockfd);
+    *received = pos;
+    return ok && pos == total && head == kHeader && tail == kTrailer;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    size_t fileSize = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 256) * 1024 * 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 4;
+    std::string path = makeFile(fileSize);
+    int fileFd = ::open(path.c_str(), O_RDONLY);
+
+    std::atomic<bool> useSendfile(false);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "sendfilebench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            return;
+        }
+        conn->send(kHeader);
+        if (useSendfile)
+        {
+            conn->sendFile(fileFd, 0, fileSize);
+        }
+        else
+        {
+            std::string content(fileSize, 0);
+            if (::pread(fileFd, &*content.begin(), fileSize, 0) != static_cast<ssize_t>(fileSize))
+            {
+                perror("pread");
+                exit(1);
+            }
+            conn->send(content);
+        }
+        conn->send(kTrailer);
+    });
+    server.setWriteCompleteCallback([](const TcpConnectionPtr &conn) {
+        conn->shutdown();
+    });
+    server.start();
+
+    std::thread client([&]() {
+        const char *names[] = {"copy", "sendfile"};
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            useSendfile = (mode == 1);
+            Timestamp start(Timestamp::now());
+            double cpuStart = cpuSeconds();
+            bool ok = true;
+            size_t received = 0;
+            for (int i = 0; i < rounds; ++i)
+            {
+                ok = download(fileSize, &received) && ok;
+            }
+            double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+            double cpu = cpuSeconds() - cpuStart;
+            printf("%-8s %d x %zu MB: %.2f s, %.0f MB/s, cpu %.2f s%s\n", names[mode], rounds, fileSize >> 20,
+                   seconds, rounds * (fileSize >> 20) / seconds, cpu, ok ? "" : "  VERIFY FAILED");
+            fflush(stdout);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    ::close(fileFd);
+    ::unlink(path.c_str());
+    return 0;
+}
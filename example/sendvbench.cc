@@ -0,0 +1,144 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 请求-应答：客户端发1字节请求，服务端回复 头部 + 正文 + 尾部，客户端收完整个应答再发下一个请求
+// concat : 头部、正文、尾部拼接成一个std::string再send，每个应答多一次正文大小的拷贝
+// sendv  : TcpConnection::sendv，一次writev发出三段
+// 客户端校验每个应答的长度和首尾字节，统计每秒应答数和进程的CPU时间
+// 用法：./sendvbench [正文KB] [请求数]
+
+static const uint16_t kPort = 9989;
+static const char kHeader[] = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n";
+static const char kTrailer[] = "\r\n0\r\n\r\n";
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int connectServer()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return sockfd;
+}
+
+// 返回是否所有应答都校验通过
+static bool request(int requests, size_t responseSize)
+{
+    int sockfd = connectServer();
+    std::string response(responseSize, 0);
+    bool ok = true;
+    for (int i = 0; i < requests; ++i)
+    {
+        if (::send(sockfd, "?", 1, 0) != 1)
+        {
+            perror("send");
+            exit(1);
+        }
+        size_t received = 0;
+        while (received < responseSize)
+        {
+            ssize_t n = ::recv(sockfd, &response[received], responseSize - received, 0);
+            if (n <= 0)
+            {
+                ::close(sockfd);
+                return false;
+            }
+            received += n;
+        }
+        ok = ok && response[0] == kHeader[0] && response[responseSize - 1] == kTrailer[sizeof kTrailer - 2]
+            && response[sizeof kHeader - 1] == 'b';
+    }
+    ::close(sockfd);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    size_t bodySize = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 16) * 1024;
+    int requests = argc > 2 ? atoi(argv[2]) : 20000;
+    const std::string body(bodySize, 'b');
+
+    std::atomic<bool> useSendv(false);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "sendvbench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        size_t n = buf->readableBytes();
+        buf->retrieveAll();
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (useSendv)
+            {
+                struct iovec slices[3];
+                slices[0].iov_base = const_cast<char *>(kHeader);
+                slices[0].iov_len = sizeof kHeader - 1;
+                slices[1].iov_base = const_cast<char *>(body.data());
+                slices[1].iov_len = body.size();
+                slices[2].iov_base = const_cast<char *>(kTrailer);
+                slices[2].iov_len = sizeof kTrailer - 1;
+                conn->sendv(slices, 3);
+            }
+            else
+            {
+                std::string response(kHeader);
+                response += body;
+                response += kTrailer;
+                conn->send(response);
+            }
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        const char *names[] = {"concat", "sendv"};
+        const size_t responseSize = sizeof kHeader - 1 + bodySize + sizeof kTrailer - 1;
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            useSendv = (mode == 1);
+            Timestamp start(Timestamp::now());
+            double cpuStart = cpuSeconds();
+            bool ok = request(requests, responseSize);
+            double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+            double cpu = cpuSeconds() - cpuStart;
+            printf("%-6s %d x %zu B responses: %.2f s, %.0f responses/s, cpu %.2f s%s\n", names[mode], requests,
+                   responseSize, seconds, requests / seconds, cpu, ok ? "" : "  VERIFY FAILED");
+            fflush(stdout);
+            ::usleep(100 * 1000);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// sendv的分片数超过IOV_MAX：一次writev只能发出前IOV_MAX个分片，剩下的进缓冲区
+// 边沿触发模式下EPOLLOUT一直注册着，enableWriting不会产生新的边沿，socket还有空间时剩下的数据必须马上接着发
+// 服务端连接建立后等连接上的事件都处理完（注册时的EPOLLOUT边沿已经上报过），在定时器里用sendv发出
+// kSlices个小分片（总共远小于socket发送缓冲区），之后不再有任何事件，客户端必须在kTimeoutMs内收齐，并校验内容
+// 用法：./sendvtest
+
+static const uint16_t kPort = 9994;
+static const int kSlices = IOV_MAX * 2 + 100;
+static const int kSliceSize = 8;
+static const int kTimeoutMs = 2000;
+
+static bool runOnce(bool edgeTriggered)
+{
+    // 分片i的内容是8个字节的'a' + i % 26
+    std::vector<std::string> data;
+    for (int i = 0; i < kSlices; ++i)
+    {
+        data.push_back(std::string(kSliceSize, static_cast<char>('a' + i % 26)));
+    }
+    std::vector<struct iovec> slices(kSlices);
+    for (int i = 0; i < kSlices; ++i)
+    {
+        slices[i].iov_base = const_cast<char *>(data[i].data());
+        slices[i].iov_len = data[i].size();
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort, "127.0.0.1"), "sendvtest");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            // 在连接所属的loop中，直接走sendvInLoop；不在读写事件的回调里，同一轮不会再有EPOLLOUT
+            conn->getLoop()->runAfter(0.1, [conn, &slices]() { conn->sendv(slices.data(), kSlices); });
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    const size_t total = static_cast<size_t>(kSlices) * kSliceSize;
+    size_t received = 0;
+    bool match = true;
+    std::thread client([&]() {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        char buf[4096];
+        struct pollfd pfd = {sockfd, POLLIN, 0};
+        while (received < total && ::poll(&pfd, 1, kTimeoutMs) > 0)
+        {
+            ssize_t n = ::read(sockfd, buf, sizeof buf);
+            if (n <= 0)
+            {
+                break;
+            }
+            for (ssize_t i = 0; i < n; ++i)
+            {
+                size_t offset = received + i;
+                match = match && buf[i] == static_cast<char>('a' + (offset / kSliceSize) % 26);
+            }
+            received += n;
+        }
+        ::close(sockfd);
+        loop.queueInLoop([&]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+
+    bool ok = received == total && match;
+    printf("%s: %s, %d slices of %d bytes, received %zu of %zu bytes%s\n", ok ? "ok  " : "FAIL",
+           edgeTriggered ? "edge-triggered " : "level-triggered", kSlices, kSliceSize, received, total,
+           match ? "" : ", content mismatch");
+    return ok;
+}
+
+int main()
+{
+    Logger::setLogLevel(ERROR);
+    bool ok = runOnce(false);
+    ok = runOnce(true) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TimerId.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// 定时器压测：在loop线程中批量添加/取消定时器，以及批量超时
+// 用法：./timerbench [定时器个数]
+
+static double elapsedSeconds(Timestamp start)
+{
+    return static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch())
+           / Timestamp::kMicroSecondsPerSecond;
+}
+
+int main(int argc, char *argv[])
+{
+    int numTimers = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    EventLoop loop;
+    std::vector<TimerId> ids;
+    ids.reserve(numTimers);
+    srand(1);
+
+    // 1. 添加numTimers个随机超时时间的定时器（都在很远的将来）
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < numTimers; ++i)
+    {
+        ids.push_back(loop.runAfter(100.0 + rand() % 10000 / 100.0, []() {}));
+    }
+    double armSec = elapsedSeconds(start);
+
+    // 2. 按随机顺序取消所有定时器
+    for (int i = numTimers - 1; i > 0; --i)
+    {
+        std::swap(ids[i], ids[rand() % (i + 1)]);
+    }
+    start = Timestamp::now();
+    for (const TimerId &id : ids)
+    {
+        loop.cancel(id);
+    }
+    double cancelSec = elapsedSeconds(start);
+
+    printf("arm    %d timers: %.3f s, %.1f ns/op\n", numTimers, armSec, armSec * 1e9 / numTimers);
+    printf("cancel %d timers: %.3f s, %.1f ns/op\n", numTimers, cancelSec, cancelSec * 1e9 / numTimers);
+
+    // 3. 添加numTimers个在1秒内超时的定时器，统计全部触发所需时间
+    int fired = 0;
+    for (int i = 0; i < numTimers; ++i)
+    {
+        loop.runAfter(rand() % 1000 / 1000.0, [&]() {
+            if (++fired == numTimers)
+            {
+                loop.quit();
+            }
+        });
+    }
+    start = Timestamp::now();
+    loop.loop();
+    printf("fire   %d timers: %.3f s (timers spread over 1 s)\n", fired, elapsedSeconds(start));
+
+    return 0;
+}
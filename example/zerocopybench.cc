@@ -0,0 +1,137 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 大帧发送：客户端连上之后服务端把同一个共享的帧send N次，发完之后shutdown，客户端读到EOF并校验
+// copy     : 零拷贝阈值为0，帧数据经过write拷贝进内核
+// zerocopy : 阈值64KB，MSG_ZEROCOPY发送，连接持有payload直到内核通知完成
+// 断开时统计连接还持有的payload引用数（应该为0），以及零拷贝是否因为内核退回拷贝被关闭（loopback一定会）
+// 用法：./zerocopybench [帧MB] [帧数]
+
+static const uint16_t kPort = 9987;
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static char frameByte(size_t offset)
+{
+    return static_cast<char>(offset * 13 + offset / 4096);
+}
+
+// 读到EOF，返回是否校验通过
+static bool download(size_t frameSize, int frames)
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(sockfd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    char buf[65536];
+    size_t received = 0;
+    bool ok = true;
+    ssize_t n;
+    while ((n = ::recv(sockfd, buf, sizeof buf, 0)) > 0)
+    {
+        for (ssize_t i = 0; i < n; i += 127)
+        {
+            if (buf[i] != frameByte((received + i) % frameSize))
+            {
+                ok = false;
+            }
+        }
+        received += n;
+    }
+    ::close(sockfd);
+    return ok && received == frameSize * frames;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    size_t frameSize = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 4) * 1024 * 1024;
+    int frames = argc > 2 ? atoi(argv[2]) : 64;
+
+    std::string *content = new std::string(frameSize, 0);
+    for (size_t i = 0; i < frameSize; ++i)
+    {
+        (*content)[i] = frameByte(i);
+    }
+    std::shared_ptr<const std::string> frame(content);
+
+    std::atomic<bool> zeroCopy(false);
+    std::atomic<long> refsAtClose(0);
+    std::atomic<bool> disabledAtClose(false);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "zerocopybench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            // 本回调和main中的frame各持有一个引用
+            refsAtClose = frame.use_count() - 1;
+            disabledAtClose = zeroCopy && conn->zeroCopyThreshold() == 0;
+            return;
+        }
+        if (zeroCopy)
+        {
+            conn->setZeroCopyThreshold(64 * 1024);
+        }
+        std::shared_ptr<const std::string> payload(frame);
+        for (int i = 0; i < frames; ++i)
+        {
+            conn->send(payload);
+        }
+    });
+    server.setWriteCompleteCallback([](const TcpConnectionPtr &conn) {
+        conn->shutdown();
+    });
+    server.start();
+
+    std::thread client([&]() {
+        const char *names[] = {"copy", "zerocopy"};
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            zeroCopy = (mode == 1);
+            Timestamp start(Timestamp::now());
+            double cpuStart = cpuSeconds();
+            bool ok = download(frameSize, frames);
+            double seconds = (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+            double cpu = cpuSeconds() - cpuStart;
+            ::usleep(100 * 1000);
+            double mb = static_cast<double>(frameSize) * frames / 1048576.0;
+            printf("%-8s %d x %zu MB: %.2f s, %.0f MB/s, cpu %.2f s, payload refs at close %ld%s%s\n", names[mode],
+                   frames, frameSize >> 20, seconds, mb / seconds, cpu, refsAtClose.load(),
+                   disabledAtClose ? ", kernel copied => zero-copy disabled" : "", ok ? "" : "  VERIFY FAILED");
+            fflush(stdout);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}